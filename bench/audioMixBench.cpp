@@ -0,0 +1,114 @@
+// Throughput of the audio mixer kernels: how many voices each one sums and
+// clips per millisecond, and how much of a device buffer's deadline a full
+// mix of that many voices takes.
+//
+//   make bench-mix MIX_BENCH_ARGS="--voices 64 --frames 256"
+
+#include <SDL3/SDL.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "audioMixer.h"
+
+struct MixBenchOptions
+{
+    int voices = 32;
+    int frames = 512;           //one mix block, as the engine uses
+    int rate = 48000;
+    int iterations = 2000;
+    bool stereoSources = false;
+    MixClip clip = MixClip::SOFT;
+};
+
+static bool parseOptions(int argc, char* argv[], MixBenchOptions &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--voices" && hasValue) {
+            options.voices = std::atoi(argv[++i]);
+        } else if (arg == "--frames" && hasValue) {
+            options.frames = std::atoi(argv[++i]);
+        } else if (arg == "--rate" && hasValue) {
+            options.rate = std::atoi(argv[++i]);
+        } else if (arg == "--iterations" && hasValue) {
+            options.iterations = std::atoi(argv[++i]);
+        } else if (arg == "--stereo") {
+            options.stereoSources = true;
+        } else if (arg == "--saturate") {
+            options.clip = MixClip::SATURATE;
+        } else {
+            return false;
+        }
+    }
+    return options.voices > 0 && options.frames > 0 && options.rate > 0 && options.iterations > 0;
+}
+
+//One block: clear, sum every voice with its own gain and pan, clip to S16
+static void mixBlock(const MixBenchOptions &options, const std::vector<std::vector<Sint16>> &sources,
+                     std::vector<float> &accumulator, std::vector<Sint16> &output)
+{
+    int sourceChannels = options.stereoSources ? 2 : 1;
+    std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+    for (int voice = 0; voice < options.voices; ++voice) {
+        float pan = static_cast<float>(voice % 9) / 4.0f - 1.0f;
+        mixVoiceS16(accumulator.data(), 2, sources[voice].data(), sourceChannels, options.frames,
+                    panGains(0.25f, pan));
+    }
+    mixdownToS16(output.data(), accumulator.data(), options.frames * 2, options.clip);
+}
+
+int main(int argc, char* argv[])
+{
+    MixBenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::printf("usage: %s [--voices N] [--frames N] [--rate HZ] [--iterations N] [--stereo] [--saturate]\n", argv[0]);
+        return 1;
+    }
+
+    int sourceChannels = options.stereoSources ? 2 : 1;
+    std::vector<std::vector<Sint16>> sources(options.voices);
+    Uint32 seed = 12345;
+    for (std::vector<Sint16> &source : sources) {
+        source.resize(static_cast<size_t>(options.frames) * sourceChannels);
+        for (Sint16 &sample : source) {
+            seed = seed * 1664525u + 1013904223u;
+            sample = static_cast<Sint16>(seed >> 16);
+        }
+    }
+    std::vector<float> accumulator(static_cast<size_t>(options.frames) * 2);
+    std::vector<Sint16> scalarOutput(accumulator.size());
+    std::vector<Sint16> output(accumulator.size());
+
+    double deadlineMs = 1000.0 * options.frames / options.rate;
+    std::printf("%d %s S16 voices -> stereo S16, %d frame blocks (%.2f ms at %d Hz), %s clip, %d iterations\n",
+                options.voices, options.stereoSources ? "stereo" : "mono", options.frames, deadlineMs,
+                options.rate, options.clip == MixClip::SOFT ? "soft" : "saturating", options.iterations);
+
+    setAudioMixKernel("scalar");
+    mixBlock(options, sources, accumulator, scalarOutput);
+
+    int exitCode = 0;
+    for (const char *kernel : { "scalar", "sse2", "avx2", "neon" }) {
+        if (!setAudioMixKernel(kernel)) continue;
+
+        Uint64 start = SDL_GetTicksNS();
+        for (int i = 0; i < options.iterations; ++i) {
+            mixBlock(options, sources, accumulator, output);
+        }
+        double elapsedMs = static_cast<double>(SDL_GetTicksNS() - start) / SDL_NS_PER_MS;
+        double msPerBlock = elapsedMs / options.iterations;
+        double voicesPerMs = static_cast<double>(options.voices) * options.iterations / elapsedMs;
+
+        //Every kernel has to match scalar exactly
+        mixBlock(options, sources, accumulator, output);
+        bool exact = output == scalarOutput;
+        std::printf("  %-8s %10.1f voices/ms %9.4f ms/block %6.2f%% of deadline  %s scalar\n",
+                    kernel, voicesPerMs, msPerBlock, 100.0 * msPerBlock / deadlineMs,
+                    exact ? "matches" : "DIFFERS FROM");
+        if (!exact) exitCode = 1;
+    }
+    return exitCode;
+}
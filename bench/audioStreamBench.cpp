@@ -0,0 +1,166 @@
+// Drives the streaming player over a real long track the way the mix thread
+// does, and checks what the request promised: every frame of the file comes
+// out, a seek restarts at the right place, a looping track never ends, and
+// resident memory stays the same however long the track is.
+//
+//   make bench-stream STREAM_BENCH_ARGS="--file assets/video/CatSpin.wav"
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "audioFileStream.h"
+
+//"A few hundred KB no matter how long the track is"
+constexpr size_t MaxResidentBytes = 512 * 1024;
+
+struct StreamBenchOptions
+{
+    std::string file = "assets/video/NeverGonna.wav";
+    int rate = 48000;
+    int channels = 2;
+    int blockFrames = 512;      //one mix block, as the engine uses
+};
+
+struct DrainResult
+{
+    Uint64 frames = 0;
+    Uint64 emptyReads = 0;      //the read-ahead was dry, the worker hadn't caught up
+    size_t residentMax = 0;
+    double elapsedMs = 0.0;
+};
+
+static bool parseOptions(int argc, char* argv[], StreamBenchOptions &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--file" && hasValue) {
+            options.file = argv[++i];
+        } else if (arg == "--rate" && hasValue) {
+            options.rate = std::atoi(argv[++i]);
+        } else if (arg == "--channels" && hasValue) {
+            options.channels = std::atoi(argv[++i]);
+        } else if (arg == "--block" && hasValue) {
+            options.blockFrames = std::atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return options.rate > 0 && options.channels > 0 && options.channels <= StreamMaxChannels &&
+           options.blockFrames > 0;
+}
+
+//Reads until the track ends, or until limit frames when it loops
+static DrainResult drainStream(AudioFileStream &stream, const StreamBenchOptions &options, Uint64 limit)
+{
+    DrainResult result;
+    std::vector<float> block(static_cast<size_t>(options.blockFrames) * options.channels);
+    Uint64 start = SDL_GetTicksNS();
+    while (result.frames < limit && !isAudioFileStreamFinished(stream)) {
+        int want = static_cast<int>(std::min<Uint64>(options.blockFrames, limit - result.frames));
+        int got = readAudioFileStream(stream, block.data(), want);
+        result.frames += static_cast<Uint64>(got);
+        result.residentMax = std::max(result.residentMax, getAudioFileStreamResidentBytes(stream));
+        if (got == 0) {
+            ++result.emptyReads;
+            SDL_Delay(1);
+        }
+    }
+    result.elapsedMs = static_cast<double>(SDL_GetTicksNS() - start) / SDL_NS_PER_MS;
+    return result;
+}
+
+//Source frames in output frames; the resampler may hold back or pad a block
+static Uint64 expectedFrames(const AudioFileStream &stream, Uint64 sourceBytes, int rate)
+{
+    Uint64 sourceFrames = sourceBytes / static_cast<Uint64>(stream.blockAlign);
+    return sourceFrames * static_cast<Uint64>(rate) / static_cast<Uint64>(stream.fileSpec.freq);
+}
+
+static bool closeTo(Uint64 frames, Uint64 expected)
+{
+    Uint64 tolerance = StreamConvertFrames * 2;
+    return frames + tolerance >= expected && frames <= expected + tolerance;
+}
+
+static bool report(const char *pass, const DrainResult &result, Uint64 expected, int rate)
+{
+    bool framesOk = expected == 0 || closeTo(result.frames, expected);
+    bool residentOk = result.residentMax <= MaxResidentBytes;
+    double audioMs = 1000.0 * static_cast<double>(result.frames) / rate;
+    std::printf("  %-8s %10llu frames (%s %llu)  %8.1f ms of audio in %7.1f ms  %llu dry reads  %zu KB resident %s\n",
+                pass, static_cast<unsigned long long>(result.frames),
+                framesOk ? "expected" : "WANTED", static_cast<unsigned long long>(expected),
+                audioMs, result.elapsedMs, static_cast<unsigned long long>(result.emptyReads),
+                result.residentMax / 1024, residentOk ? "" : "OVER BUDGET");
+    return framesOk && residentOk;
+}
+
+int main(int argc, char* argv[])
+{
+    StreamBenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::printf("usage: %s [--file track.wav] [--rate HZ] [--channels N] [--block FRAMES]\n", argv[0]);
+        return 1;
+    }
+
+    SDL_AudioSpec outSpec;
+    SDL_zero(outSpec);
+    outSpec.format = SDL_AUDIO_F32;
+    outSpec.channels = options.channels;
+    outSpec.freq = options.rate;
+
+    int exitCode = 0;
+
+    //Whole track, start to end
+    AudioFileStream *stream = new AudioFileStream();
+    if (!openAudioFileStream(*stream, options.file, outSpec, false)) {
+        delete stream;
+        return 1;
+    }
+    Uint64 trackBytes = stream->dataBytes;
+    Uint64 trackFrames = expectedFrames(*stream, trackBytes, options.rate);
+    std::printf("%s: %d Hz, %d channels, %llu bytes of PCM -> %d Hz %d channel float, %d frame reads\n",
+                options.file.c_str(), stream->fileSpec.freq, stream->fileSpec.channels,
+                static_cast<unsigned long long>(trackBytes), options.rate, options.channels,
+                options.blockFrames);
+    if (!report("full", drainStream(*stream, options, trackFrames * 2), trackFrames, options.rate)) exitCode = 1;
+    closeAudioFileStream(*stream);
+    delete stream;
+
+    //From halfway, once the worker has picked the seek up
+    stream = new AudioFileStream();
+    if (openAudioFileStream(*stream, options.file, outSpec, false)) {
+        Uint64 offset = trackBytes / 2;
+        offset -= offset % static_cast<Uint64>(stream->blockAlign);
+        Uint32 epoch = stream->epoch.load(std::memory_order_acquire);
+        seekAudioFileStream(*stream, offset);
+        while (stream->epoch.load(std::memory_order_acquire) == epoch) {
+            SDL_Delay(1);
+        }
+        Uint64 expected = expectedFrames(*stream, trackBytes - offset, options.rate);
+        if (!report("seek", drainStream(*stream, options, trackFrames * 2), expected, options.rate)) exitCode = 1;
+        closeAudioFileStream(*stream);
+    } else {
+        exitCode = 1;
+    }
+    delete stream;
+
+    //Looping has to carry on past the end without finishing
+    stream = new AudioFileStream();
+    if (openAudioFileStream(*stream, options.file, outSpec, true)) {
+        Uint64 limit = trackFrames + trackFrames / 2;
+        DrainResult result = drainStream(*stream, options, limit);
+        if (!report("loop", result, limit, options.rate)) exitCode = 1;
+        closeAudioFileStream(*stream);
+    } else {
+        exitCode = 1;
+    }
+    delete stream;
+
+    return exitCode;
+}
@@ -0,0 +1,155 @@
+// Throughput of the built-in YUV 4:2:0 to RGBA kernels against sws_scale
+// doing the same identity-size conversion the RGB_CONVERT path used to do.
+//
+//   make bench-color COLOR_BENCH_ARGS="--size 3840x2160 --nv12"
+
+#include <SDL3/SDL.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "colorConvert.h"
+
+extern "C"
+{
+    #include <libavutil/frame.h>
+    #include <libswscale/swscale.h>
+}
+
+struct ColorBenchOptions
+{
+    int width = 1920;
+    int height = 1080;
+    int iterations = 200;
+    bool nv12 = false;
+};
+
+static bool parseOptions(int argc, char* argv[], ColorBenchOptions &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) return false;
+        } else if (arg == "--iterations" && hasValue) {
+            options.iterations = std::atoi(argv[++i]);
+        } else if (arg == "--nv12") {
+            options.nv12 = true;
+        } else {
+            return false;
+        }
+    }
+    return options.width > 0 && options.height > 0 && options.iterations > 0;
+}
+
+static AVFrame* makeSourceFrame(const ColorBenchOptions &options)
+{
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) return nullptr;
+    frame->format = options.nv12 ? AV_PIX_FMT_NV12 : AV_PIX_FMT_YUV420P;
+    frame->width = options.width;
+    frame->height = options.height;
+    frame->color_range = AVCOL_RANGE_MPEG;
+    frame->colorspace = AVCOL_SPC_BT709;
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return nullptr;
+    }
+
+    Uint32 seed = 12345;
+    int planes = options.nv12 ? 2 : 3;
+    for (int plane = 0; plane < planes; ++plane) {
+        int rows = plane == 0 ? options.height : (options.height + 1) / 2;
+        for (int row = 0; row < rows; ++row) {
+            Uint8 *line = frame->data[plane] + row * frame->linesize[plane];
+            for (int x = 0; x < frame->linesize[plane]; ++x) {
+                seed = seed * 1664525u + 1013904223u;
+                line[x] = static_cast<Uint8>(seed >> 24);
+            }
+        }
+    }
+    return frame;
+}
+
+static void report(const char *name, Uint64 elapsedNS, const ColorBenchOptions &options, double baselineMs)
+{
+    double msPerFrame = static_cast<double>(elapsedNS) / SDL_NS_PER_MS / options.iterations;
+    double megapixels = static_cast<double>(options.width) * options.height / 1e6;
+    std::printf("  %-14s %9.3f ms/frame %9.1f Mpix/s", name, msPerFrame, megapixels / (msPerFrame / 1000.0));
+    if (baselineMs > 0.0) std::printf("  %5.2fx sws", baselineMs / msPerFrame);
+    std::printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+    ColorBenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::printf("usage: %s [--size WxH] [--iterations N] [--nv12]\n", argv[0]);
+        return 1;
+    }
+
+    AVFrame *source = makeSourceFrame(options);
+    if (!source) {
+        std::fprintf(stderr, "Failed to allocate source frame\n");
+        return 1;
+    }
+    int stride = options.width * 4;
+    std::vector<Uint8> swsOutput(static_cast<size_t>(stride) * options.height);
+    std::vector<Uint8> scalarOutput(swsOutput.size());
+    std::vector<Uint8> output(swsOutput.size());
+
+    std::printf("%dx%d %s -> RGBA, %d iterations\n", options.width, options.height,
+                options.nv12 ? "NV12" : "YUV420P", options.iterations);
+
+    //The old path: a bilinear context that never actually scales
+    SwsContext *sws = sws_getContext(options.width, options.height, static_cast<AVPixelFormat>(source->format),
+                                     options.width, options.height, AV_PIX_FMT_RGBA,
+                                     SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws) {
+        std::fprintf(stderr, "Failed to create SwsContext\n");
+        av_frame_free(&source);
+        return 1;
+    }
+    const int *coefficients = sws_getCoefficients(SWS_CS_ITU709);
+    sws_setColorspaceDetails(sws, coefficients, 0, coefficients, 1, 0, 1 << 16, 1 << 16);
+    Uint8 *swsPlanes[4] = { swsOutput.data(), nullptr, nullptr, nullptr };
+    int swsStrides[4] = { stride, 0, 0, 0 };
+
+    Uint64 start = SDL_GetTicksNS();
+    for (int i = 0; i < options.iterations; ++i) {
+        sws_scale(sws, source->data, source->linesize, 0, options.height, swsPlanes, swsStrides);
+    }
+    Uint64 swsNS = SDL_GetTicksNS() - start;
+    double swsMs = static_cast<double>(swsNS) / SDL_NS_PER_MS / options.iterations;
+    report("sws_scale", swsNS, options, 0.0);
+    sws_freeContext(sws);
+
+    setColorConvertKernel("scalar");
+    convertFrameToRGBA(source, RGBAOrder::RGBA, scalarOutput.data(), stride);
+
+    int exitCode = 0;
+    for (const char *kernel : { "scalar", "sse2", "avx2", "neon" }) {
+        if (!setColorConvertKernel(kernel)) continue;
+
+        start = SDL_GetTicksNS();
+        for (int i = 0; i < options.iterations; ++i) {
+            convertFrameToRGBA(source, RGBAOrder::RGBA, output.data(), stride);
+        }
+        report(kernel, SDL_GetTicksNS() - start, options, swsMs);
+
+        //Kernels must match scalar exactly; against swscale only rounding
+        int maxDiff = 0;
+        bool exact = output == scalarOutput;
+        for (size_t i = 0; i < output.size(); ++i) {
+            int diff = std::abs(static_cast<int>(output[i]) - static_cast<int>(swsOutput[i]));
+            if (diff > maxDiff) maxDiff = diff;
+        }
+        std::printf("  %-14s %s scalar, max difference from sws %d\n", "",
+                    exact ? "matches" : "DIFFERS FROM", maxDiff);
+        if (!exact) exitCode = 1;
+    }
+
+    av_frame_free(&source);
+    return exitCode;
+}
@@ -0,0 +1,325 @@
+// Headless benchmark of the video path: loadMP4 -> decoder worker ->
+// getNextFrame upload, on SDL's offscreen (or dummy) video driver.
+//
+//   make bench BENCH_ARGS="--size 1280x720 --seconds 10 --rgb"
+//
+// Decoder threading and lowres come from the usual ATARAXIA_VIDEO_*
+// environment variables, so runs can be compared by changing only those.
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+#include "videoRendering.h"
+#include "videoDecoder.h"
+#include "videoCache.h"
+#include "colorConvert.h"
+
+extern "C"
+{
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+}
+
+struct BenchOptions
+{
+    int width = 1280;
+    int height = 720;
+    int fps = 30;
+    int seconds = 10;
+    int passes = 1;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    bool rgb = false;
+    bool cache = false;
+    std::string clipPath = "bench_clip.mp4";
+};
+
+static void printUsage(const char *program)
+{
+    std::printf("usage: %s [--size WxH] [--target WxH] [--fps N] [--seconds N] [--passes N] [--rgb] [--cache] [--clip path]\n",
+                program);
+}
+
+static bool parseOptions(int argc, char* argv[], BenchOptions &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) return false;
+        } else if (arg == "--target" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.targetWidth, &options.targetHeight) != 2) return false;
+        } else if (arg == "--fps" && hasValue) {
+            options.fps = std::atoi(argv[++i]);
+        } else if (arg == "--seconds" && hasValue) {
+            options.seconds = std::atoi(argv[++i]);
+        } else if (arg == "--passes" && hasValue) {
+            options.passes = std::atoi(argv[++i]);
+        } else if (arg == "--clip" && hasValue) {
+            options.clipPath = argv[++i];
+        } else if (arg == "--rgb") {
+            options.rgb = true;
+        } else if (arg == "--cache") {
+            options.cache = true;
+        } else {
+            return false;
+        }
+    }
+    return options.width > 0 && options.height > 0 && options.fps > 0 &&
+           options.seconds > 0 && options.passes > 0;
+}
+
+//Moving gradients with a grain texture on top, so the encoder can't reduce
+//every frame to a handful of skip blocks
+static void fillTestFrame(AVFrame *frame, int index)
+{
+    Uint32 seed = 0x9e3779b9u * static_cast<Uint32>(index + 1);
+    for (int y = 0; y < frame->height; ++y) {
+        uint8_t *row = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < frame->width; ++x) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            row[x] = static_cast<uint8_t>(x + y + index * 3 + (seed & 15));
+        }
+    }
+    for (int y = 0; y < frame->height / 2; ++y) {
+        uint8_t *u = frame->data[1] + y * frame->linesize[1];
+        uint8_t *v = frame->data[2] + y * frame->linesize[2];
+        for (int x = 0; x < frame->width / 2; ++x) {
+            u[x] = static_cast<uint8_t>(128 + y + index * 2);
+            v[x] = static_cast<uint8_t>(64 + x + index * 5);
+        }
+    }
+}
+
+static bool writeEncodedPackets(AVCodecContext *encoder, const AVFrame *frame, AVPacket *packet,
+                                AVFormatContext *output, AVStream *stream)
+{
+    if (avcodec_send_frame(encoder, frame) < 0) return false;
+    for (;;) {
+        int ret = avcodec_receive_packet(encoder, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return true;
+        if (ret < 0) return false;
+        av_packet_rescale_ts(packet, encoder->time_base, stream->time_base);
+        packet->stream_index = stream->index;
+        if (av_interleaved_write_frame(output, packet) < 0) return false;
+    }
+}
+
+//Encodes the synthetic clip with whatever H.264 (or failing that MPEG-4
+//Part 2) encoder this libavcodec build has
+static bool writeTestClip(const BenchOptions &options)
+{
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!codec) codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    if (!codec) {
+        std::fprintf(stderr, "No H.264 or MPEG-4 encoder available\n");
+        return false;
+    }
+
+    AVFormatContext *output = nullptr;
+    if (avformat_alloc_output_context2(&output, nullptr, "mp4", options.clipPath.c_str()) < 0) {
+        std::fprintf(stderr, "Failed to create mp4 muxer\n");
+        return false;
+    }
+    AVStream *stream = avformat_new_stream(output, nullptr);
+    AVCodecContext *encoder = avcodec_alloc_context3(codec);
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    bool ok = stream && encoder && frame && packet;
+
+    if (ok) {
+        encoder->width = options.width;
+        encoder->height = options.height;
+        encoder->pix_fmt = AV_PIX_FMT_YUV420P;
+        encoder->time_base = AVRational{1, options.fps};
+        encoder->framerate = AVRational{options.fps, 1};
+        encoder->gop_size = options.fps;
+        encoder->max_b_frames = 2;
+        encoder->bit_rate = static_cast<int64_t>(options.width) * options.height * options.fps / 10;
+        if (output->oformat->flags & AVFMT_GLOBALHEADER) {
+            encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        ok = avcodec_open2(encoder, codec, nullptr) >= 0 &&
+             avcodec_parameters_from_context(stream->codecpar, encoder) >= 0;
+    }
+    if (ok) {
+        stream->time_base = encoder->time_base;
+        ok = avio_open(&output->pb, options.clipPath.c_str(), AVIO_FLAG_WRITE) >= 0 &&
+             avformat_write_header(output, nullptr) >= 0;
+    }
+    if (ok) {
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = options.width;
+        frame->height = options.height;
+        ok = av_frame_get_buffer(frame, 0) >= 0;
+    }
+
+    int frameCount = options.fps * options.seconds;
+    for (int i = 0; ok && i < frameCount; ++i) {
+        ok = av_frame_make_writable(frame) >= 0;
+        if (!ok) break;
+        fillTestFrame(frame, i);
+        frame->pts = i;
+        ok = writeEncodedPackets(encoder, frame, packet, output, stream);
+    }
+    if (ok) {
+        ok = writeEncodedPackets(encoder, nullptr, packet, output, stream) &&
+             av_write_trailer(output) >= 0;
+    }
+
+    if (!ok) std::fprintf(stderr, "Failed to write test clip %s\n", options.clipPath.c_str());
+    else std::printf("Test clip: %s, %s %dx%d, %d frames\n", options.clipPath.c_str(), codec->name,
+                     options.width, options.height, frameCount);
+
+    if (output->pb) avio_closep(&output->pb);
+    avformat_free_context(output);
+    avcodec_free_context(&encoder);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    return ok;
+}
+
+static double percentileMs(std::vector<Uint64> &samples, double fraction)
+{
+    if (samples.empty()) return 0.0;
+    size_t index = static_cast<size_t>(fraction * (samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return static_cast<double>(samples[index]) / SDL_NS_PER_MS;
+}
+
+static void printStage(const char *name, std::vector<Uint64> &samples)
+{
+    double p50 = percentileMs(samples, 0.50);
+    double p90 = percentileMs(samples, 0.90);
+    double p99 = percentileMs(samples, 0.99);
+    double max = percentileMs(samples, 1.0);
+    std::printf("  %-8s %8zu %9.3f %9.3f %9.3f %9.3f\n", name, samples.size(), p50, p90, p99, max);
+}
+
+static double peakRSSMegabytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+#ifdef __APPLE__
+    return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0);   //bytes
+#else
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;              //kilobytes
+#endif
+}
+
+//Decodes and uploads the test clip; the caller owns SDL and the renderer
+static int runBench(const BenchOptions &options, SDL_Renderer *renderer)
+{
+    int frameCount = options.fps * options.seconds * options.passes;
+    VideoStageTimings timings;
+    timings.demuxNS.reserve(frameCount);
+    timings.decodeNS.reserve(frameCount);
+    timings.convertNS.reserve(frameCount);
+    std::vector<Uint64> uploadNS;
+    uploadNS.reserve(frameCount);
+
+    VideoState video;
+    if (options.cache) {
+        configureVideoCache(static_cast<size_t>(1) << 30, options.seconds + 1.0);
+        video.cacheEnabled = true;
+    }
+    VideoDecodeOptions decodeOptions = videoDecodeOptionsFromEnvironment();
+    decodeOptions.targetWidth = options.targetWidth;
+    decodeOptions.targetHeight = options.targetHeight;
+    if (!loadMP4(options.clipPath, video, decodeOptions)) {
+        closeVideo(video);
+        return 1;
+    }
+    video.looping = options.passes > 1;
+    video.playbackMode = options.rgb ? VideoPlaybackMode::RGB_CONVERT : VideoPlaybackMode::STREAMING_YUV;
+    video.stageTimings = &timings;
+
+    Uint64 start = SDL_GetTicksNS();
+    if (!startVideoDecoder(video)) {
+        closeVideo(video);
+        clearVideoCache();
+        return 1;
+    }
+
+    //No clock: every frame is uploaded as soon as the worker has it
+    int presented = 0;
+    while (presented < frameCount) {
+        Uint64 uploadStart = SDL_GetTicksNS();
+        SDL_Texture *texture = getNextFrame(video, renderer);
+        if (texture) {
+            uploadNS.push_back(SDL_GetTicksNS() - uploadStart);
+            SDL_RenderTexture(renderer, texture, nullptr, nullptr);
+            SDL_RenderPresent(renderer);
+            ++presented;
+            continue;
+        }
+        if (video.decodeFinished && !peekReadableSlot(video.frameQueue)) break;
+        SDL_DelayNS(100000);
+    }
+    double elapsed = static_cast<double>(SDL_GetTicksNS() - start) / SDL_NS_PER_SECOND;
+    stopVideoDecoder(video);
+
+    int exitCode = 0;
+    if (presented < frameCount) {
+        std::fprintf(stderr, "Decoder stopped after %d of %d frames\n", presented, frameCount);
+        exitCode = 1;
+    }
+
+    std::string mode = options.rgb ? std::string("RGBA convert, ") + getColorConvertKernelName() + " kernel"
+                                   : std::string("YUV streaming");
+    std::printf("Driver %s, renderer %s, %s, %d pass(es)%s\n", SDL_GetCurrentVideoDriver(),
+                SDL_GetRendererName(renderer), mode.c_str(), options.passes,
+                options.cache ? ", clip cache" : "");
+    std::printf("Frames: %d in %.3f s, %.1f fps (%llu decoded)\n", presented, elapsed,
+                elapsed > 0.0 ? presented / elapsed : 0.0,
+                static_cast<unsigned long long>(video.stats.framesDecoded));
+    std::printf("  stage      count   p50 ms    p90 ms    p99 ms    max ms\n");
+    printStage("demux", timings.demuxNS);
+    printStage("decode", timings.decodeNS);
+    printStage("convert", timings.convertNS);
+    printStage("upload", uploadNS);
+    std::printf("Peak RSS: %.1f MB\n", peakRSSMegabytes());
+    if (options.cache) logVideoCacheStats();
+
+    closeVideo(video);
+    clearVideoCache();
+    return exitCode;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen,dummy");
+    if (!SDL_Init(SDL_INIT_VIDEO)) {
+        std::fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    //Every path from here on goes through the cleanup below
+    int exitCode = 1;
+    SDL_Window *window = SDL_CreateWindow("videoDecodeBench", options.width, options.height, SDL_WINDOW_HIDDEN);
+    SDL_Renderer *renderer = window ? SDL_CreateRenderer(window, nullptr) : nullptr;
+    if (!renderer) {
+        std::fprintf(stderr, "No renderer on the %s driver: %s\n", SDL_GetCurrentVideoDriver(), SDL_GetError());
+    } else if (writeTestClip(options)) {
+        exitCode = runBench(options, renderer);
+    }
+
+    if (renderer) SDL_DestroyRenderer(renderer);
+    if (window) SDL_DestroyWindow(window);
+    SDL_Quit();
+    return exitCode;
+}
@@ -0,0 +1,113 @@
+#include "allocationCounter.h"
+
+#ifdef ATARAXIA_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static thread_local Uint64 threadAllocations = 0;
+static std::atomic<Uint64> totalAllocations{0};
+
+static SDL_malloc_func originalMalloc = nullptr;
+static SDL_calloc_func originalCalloc = nullptr;
+static SDL_realloc_func originalRealloc = nullptr;
+static SDL_free_func originalFree = nullptr;
+
+static void countAllocation()
+{
+    ++threadAllocations;
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void* SDLCALL countingMalloc(size_t size)
+{
+    countAllocation();
+    return originalMalloc(size);
+}
+
+static void* SDLCALL countingCalloc(size_t count, size_t size)
+{
+    countAllocation();
+    return originalCalloc(count, size);
+}
+
+static void* SDLCALL countingRealloc(void *mem, size_t size)
+{
+    countAllocation();
+    return originalRealloc(mem, size);
+}
+
+static void SDLCALL countingFree(void *mem)
+{
+    originalFree(mem);
+}
+
+bool allocationCounterEnabled()
+{
+    return true;
+}
+
+bool installAllocationCounter()
+{
+    if (originalMalloc) return true;
+    SDL_GetOriginalMemoryFunctions(&originalMalloc, &originalCalloc, &originalRealloc, &originalFree);
+    if (!SDL_SetMemoryFunctions(countingMalloc, countingCalloc, countingRealloc, countingFree)) {
+        SDL_Log("Failed to install allocation counter: %s", SDL_GetError());
+        originalMalloc = nullptr;
+        return false;
+    }
+    return true;
+}
+
+Uint64 getThreadAllocationCount()
+{
+    return threadAllocations;
+}
+
+Uint64 getTotalAllocationCount()
+{
+    return totalAllocations.load(std::memory_order_relaxed);
+}
+
+//Every C++ allocation in the program goes through these
+void* operator new(std::size_t size)
+{
+    countAllocation();
+    if (void *mem = std::malloc(size ? size : 1)) return mem;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *mem) noexcept
+{
+    std::free(mem);
+}
+
+void operator delete(void *mem, std::size_t) noexcept
+{
+    std::free(mem);
+}
+
+#else
+
+bool allocationCounterEnabled()
+{
+    return false;
+}
+
+bool installAllocationCounter()
+{
+    return true;
+}
+
+Uint64 getThreadAllocationCount()
+{
+    return 0;
+}
+
+Uint64 getTotalAllocationCount()
+{
+    return 0;
+}
+
+#endif
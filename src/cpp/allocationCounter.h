@@ -0,0 +1,21 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <SDL3/SDL.h>
+
+//Debug accounting of heap allocations, used to check that the steady-state
+//video path doesn't allocate. Built with ATARAXIA_COUNT_ALLOCATIONS it counts
+//every SDL_malloc/calloc/realloc and every global operator new, per thread.
+//Allocations libav makes through its own av_malloc aren't visible here,
+//libavutil has no allocator hook, so a zero count says nothing about them.
+//Without the flag everything is a no-op and the counts stay zero.
+bool allocationCounterEnabled();
+
+//Routes SDL's allocator through the counter. Must be called before anything
+//else touches SDL, including TTF_Init().
+bool installAllocationCounter();
+
+Uint64 getThreadAllocationCount();
+Uint64 getTotalAllocationCount();
+
+#endif
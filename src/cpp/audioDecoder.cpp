@@ -0,0 +1,220 @@
+#include "audioDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C"
+{
+    #include <libavutil/channel_layout.h>
+}
+
+constexpr int MaxDecodeChannels = 8;
+
+static void logAVError(const char *what, int err)
+{
+    char message[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(err, message, sizeof(message));
+    SDL_Log("%s: %s", what, message);
+}
+
+bool isWavPath(const std::string &path)
+{
+    return path.size() >= 4 && SDL_strcasecmp(path.c_str() + path.size() - 4, ".wav") == 0;
+}
+
+bool openAudioDecoder(AudioDecoder &decoder, const std::string &path)
+{
+    int ret = avformat_open_input(&decoder.formatCtx, path.c_str(), nullptr, nullptr);
+    if (ret < 0) {
+        logAVError(("Could not open " + path).c_str(), ret);
+        return false;
+    }
+    if ((ret = avformat_find_stream_info(decoder.formatCtx, nullptr)) < 0) {
+        logAVError("avformat_find_stream_info failed", ret);
+        closeAudioDecoder(decoder);
+        return false;
+    }
+
+    const AVCodec *codec = nullptr;
+    decoder.streamIndex = av_find_best_stream(decoder.formatCtx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (decoder.streamIndex < 0 || !codec) {
+        SDL_Log("%s has no decodable audio stream", path.c_str());
+        closeAudioDecoder(decoder);
+        return false;
+    }
+
+    AVStream *stream = decoder.formatCtx->streams[decoder.streamIndex];
+    decoder.codecCtx = avcodec_alloc_context3(codec);
+    if (!decoder.codecCtx || avcodec_parameters_to_context(decoder.codecCtx, stream->codecpar) < 0) {
+        SDL_Log("Could not copy audio codec parameters for %s", path.c_str());
+        closeAudioDecoder(decoder);
+        return false;
+    }
+    decoder.codecCtx->pkt_timebase = stream->time_base;
+    if (avcodec_open2(decoder.codecCtx, codec, nullptr) < 0) {
+        SDL_Log("Could not open the %s decoder for %s", codec->name, path.c_str());
+        closeAudioDecoder(decoder);
+        return false;
+    }
+
+    int channels = std::min(decoder.codecCtx->ch_layout.nb_channels, MaxDecodeChannels);
+    SDL_zero(decoder.spec);
+    decoder.spec.format = SDL_AUDIO_S16;
+    decoder.spec.channels = channels;
+    decoder.spec.freq = decoder.codecCtx->sample_rate;
+    decoder.frameBytes = SDL_AUDIO_FRAMESIZE(decoder.spec);
+
+    AVChannelLayout outLayout;
+    av_channel_layout_default(&outLayout, channels);
+    ret = swr_alloc_set_opts2(&decoder.swrCtx,
+                              &outLayout, AV_SAMPLE_FMT_S16, decoder.spec.freq,
+                              &decoder.codecCtx->ch_layout, decoder.codecCtx->sample_fmt,
+                              decoder.codecCtx->sample_rate, 0, nullptr);
+    av_channel_layout_uninit(&outLayout);
+    if (ret < 0 || (ret = swr_init(decoder.swrCtx)) < 0) {
+        logAVError("Could not set up audio resampler", ret);
+        closeAudioDecoder(decoder);
+        return false;
+    }
+
+    decoder.packet = av_packet_alloc();
+    decoder.frame = av_frame_alloc();
+    if (!decoder.packet || !decoder.frame) {
+        closeAudioDecoder(decoder);
+        return false;
+    }
+
+    if (decoder.formatCtx->duration > 0) {
+        double seconds = static_cast<double>(decoder.formatCtx->duration) / AV_TIME_BASE;
+        decoder.estimatedBytes = static_cast<Uint64>(seconds * decoder.spec.freq) * decoder.frameBytes;
+    }
+    decoder.draining = false;
+    decoder.finished = false;
+    decoder.seekTargetFrame = -1;
+    return true;
+}
+
+void closeAudioDecoder(AudioDecoder &decoder)
+{
+    if (decoder.frame) av_frame_free(&decoder.frame);
+    if (decoder.packet) av_packet_free(&decoder.packet);
+    if (decoder.swrCtx) swr_free(&decoder.swrCtx);
+    if (decoder.codecCtx) avcodec_free_context(&decoder.codecCtx);
+    if (decoder.formatCtx) avformat_close_input(&decoder.formatCtx);
+    decoder.streamIndex = -1;
+    decoder.pcm.clear();
+    decoder.pcm.shrink_to_fit();
+}
+
+//Converts the frame in decoder.frame (or, with nullptr, what swresample
+//still holds) into decoder.pcm. Returns the bytes produced.
+static int convertAudioFrame(AudioDecoder &decoder, const AVFrame *frame)
+{
+    int inSamples = frame ? frame->nb_samples : 0;
+    int outSamples = swr_get_out_samples(decoder.swrCtx, inSamples);
+    if (outSamples <= 0) return 0;
+
+    size_t needed = static_cast<size_t>(outSamples) * decoder.frameBytes;
+    if (decoder.pcm.size() < needed) decoder.pcm.resize(needed);
+
+    uint8_t *out[1] = { decoder.pcm.data() };
+    int converted = swr_convert(decoder.swrCtx, out, outSamples,
+                                frame ? frame->extended_data : nullptr, inSamples);
+    if (converted < 0) {
+        logAVError("swr_convert failed", converted);
+        return 0;
+    }
+    int bytes = converted * decoder.frameBytes;
+
+    //Seeks land on the packet before the target, trim up to it
+    if (frame && decoder.seekTargetFrame >= 0 && frame->pts != AV_NOPTS_VALUE) {
+        //The seek target counts from the start of the stream, not from pts 0
+        const AVStream *stream = decoder.formatCtx->streams[decoder.streamIndex];
+        Sint64 pts = frame->pts;
+        if (stream->start_time != AV_NOPTS_VALUE) pts -= stream->start_time;
+        Sint64 firstFrame = static_cast<Sint64>(pts * av_q2d(stream->time_base) * decoder.spec.freq + 0.5);
+        Sint64 skip = std::min<Sint64>(std::max<Sint64>(decoder.seekTargetFrame - firstFrame, 0), converted);
+        if (skip > 0) {
+            bytes -= static_cast<int>(skip) * decoder.frameBytes;
+            std::memmove(decoder.pcm.data(), decoder.pcm.data() + skip * decoder.frameBytes, bytes);
+        }
+        if (skip < converted) decoder.seekTargetFrame = -1;
+    }
+    return bytes;
+}
+
+int decodeAudioChunk(AudioDecoder &decoder)
+{
+    if (decoder.finished) return 0;
+
+    while (true) {
+        int ret = avcodec_receive_frame(decoder.codecCtx, decoder.frame);
+        if (ret == 0) {
+            int bytes = convertAudioFrame(decoder, decoder.frame);
+            av_frame_unref(decoder.frame);
+            if (bytes > 0) return bytes;
+            continue;
+        }
+        if (ret == AVERROR_EOF) {
+            decoder.finished = true;
+            return convertAudioFrame(decoder, nullptr);
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            logAVError("Audio avcodec_receive_frame failed", ret);
+            return -1;
+        }
+
+        ret = av_read_frame(decoder.formatCtx, decoder.packet);
+        if (ret < 0) {
+            if (ret != AVERROR_EOF) logAVError("Audio av_read_frame failed", ret);
+            if (!decoder.draining) {
+                avcodec_send_packet(decoder.codecCtx, nullptr);
+                decoder.draining = true;
+            }
+            continue;
+        }
+        if (decoder.packet->stream_index == decoder.streamIndex) {
+            ret = avcodec_send_packet(decoder.codecCtx, decoder.packet);
+            if (ret < 0 && ret != AVERROR(EAGAIN)) {
+                logAVError("Audio avcodec_send_packet failed", ret);
+            }
+        }
+        av_packet_unref(decoder.packet);
+    }
+}
+
+bool seekAudioDecoder(AudioDecoder &decoder, Uint64 byteOffset)
+{
+    Sint64 targetFrame = static_cast<Sint64>(byteOffset / decoder.frameBytes);
+    AVStream *stream = decoder.formatCtx->streams[decoder.streamIndex];
+    double seconds = static_cast<double>(targetFrame) / decoder.spec.freq;
+    Sint64 timestamp = static_cast<Sint64>(seconds / av_q2d(stream->time_base));
+    if (stream->start_time != AV_NOPTS_VALUE) timestamp += stream->start_time;
+
+    int ret = av_seek_frame(decoder.formatCtx, decoder.streamIndex, timestamp, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        logAVError("Audio seek failed", ret);
+        return false;
+    }
+    avcodec_flush_buffers(decoder.codecCtx);
+    decoder.draining = false;
+    decoder.finished = false;
+    decoder.seekTargetFrame = targetFrame > 0 ? targetFrame : -1;
+    return true;
+}
+
+bool decodeAudioFile(const std::string &path, SDL_AudioSpec &spec, std::vector<Uint8> &pcm)
+{
+    AudioDecoder decoder;
+    if (!openAudioDecoder(decoder, path)) return false;
+
+    pcm.clear();
+    pcm.reserve(static_cast<size_t>(decoder.estimatedBytes));
+    int bytes;
+    while ((bytes = decodeAudioChunk(decoder)) > 0) {
+        pcm.insert(pcm.end(), decoder.pcm.data(), decoder.pcm.data() + bytes);
+    }
+    spec = decoder.spec;
+    closeAudioDecoder(decoder);
+    return bytes == 0 && !pcm.empty();
+}
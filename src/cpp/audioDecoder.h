@@ -0,0 +1,53 @@
+#ifndef AUDIO_DECODER_H
+#define AUDIO_DECODER_H
+
+#include <string>
+#include <vector>
+#include <SDL3/SDL.h>
+
+extern "C"
+{
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+    #include <libswresample/swresample.h>
+}
+
+//Decodes any audio file libavformat can open (Ogg Vorbis, Opus, MP3, FLAC,
+//AAC...) one packet at a time. Output is interleaved S16 at the file's own
+//rate and channel count; swresample only un-planarizes and narrows, so the
+//caller resamples to whatever it needs.
+struct AudioDecoder
+{
+    AVFormatContext *formatCtx = nullptr;
+    AVCodecContext *codecCtx = nullptr;
+    SwrContext *swrCtx = nullptr;
+    AVPacket *packet = nullptr;
+    AVFrame *frame = nullptr;
+    int streamIndex = -1;
+    SDL_AudioSpec spec;
+    int frameBytes = 0;
+    Uint64 estimatedBytes = 0;      //PCM length from the container, 0 if unknown
+
+    std::vector<Uint8> pcm;         //last decoded chunk, reused between calls
+    bool draining = false;          //null packet sent, waiting for AVERROR_EOF
+    bool finished = false;
+    Sint64 seekTargetFrame = -1;    //samples before this are dropped after a seek
+};
+
+bool openAudioDecoder(AudioDecoder &decoder, const std::string &path);
+void closeAudioDecoder(AudioDecoder &decoder);
+
+//Decodes the next chunk into decoder.pcm. Returns its size in bytes, 0 at
+//the end of the stream and -1 on an error.
+int decodeAudioChunk(AudioDecoder &decoder);
+//Restarts decoding at byteOffset into the PCM, as counted in decoder.spec
+bool seekAudioDecoder(AudioDecoder &decoder, Uint64 byteOffset);
+
+//Decodes a whole file at once, for short sounds that are decoded once and
+//kept in memory
+bool decodeAudioFile(const std::string &path, SDL_AudioSpec &spec, std::vector<Uint8> &pcm);
+
+//WAV files go through SDL's own loader, everything else through libav
+bool isWavPath(const std::string &path);
+
+#endif
@@ -0,0 +1,613 @@
+#include "audioEngine.h"
+#include "audioRingBuffer.h"
+#include "audioMixer.h"
+#include "audioLatency.h"
+#include "audioFileStream.h"
+#include "audioDecoder.h"
+
+#include <algorithm>
+#include <vector>
+
+//Mixing happens in blocks of this many frames, in buffers sized once
+constexpr int MixBlockFrames = 512;
+constexpr int MaxMixChannels = 8;
+constexpr size_t InitialVoiceCapacity = 32;
+constexpr int MaxSoundEffects = 64;
+constexpr int MaxPendingCommands = 64;
+//A new sound waits behind whatever is already mixed, so both the device
+//buffer and how far the mix thread runs ahead of it count against the 20 ms
+//input-to-audio target. The device buffer is only a request; the mix-ahead
+//is never less than what the device actually asks for per callback, and the
+//ring holds a few times that so a late wakeup never drops mixed audio.
+constexpr int DeviceSampleFrames = 256;
+constexpr int MinMixAheadFrames = 256;
+constexpr int MixRingAheadMultiple = 4;
+//The callback can't wake the mix thread (an SDL semaphore is a mutex and a
+//condition variable on some platforms), so the thread also polls, often
+//enough to top the ring up a couple of times per mix-ahead
+constexpr Sint32 MixWakeTimeoutMS = 5;
+//Dozens of overlapping voices can go past full scale, round them off
+//instead of hard clipping
+constexpr MixClip EngineClip = MixClip::SOFT;
+
+struct SoundEffect
+{
+    //S16 at the device rate, mono or in the device's channel layout. Half
+    //the memory and bandwidth of float; the mixer widens it per block.
+    std::vector<Sint16> samples;
+    int channels = 1;
+    int frames = 0;
+};
+
+struct AudioVoice
+{
+    const SoundEffect *effect = nullptr;
+    int position = 0;               //next frame to play
+    MixGains gains;
+};
+
+enum class AudioCommandType
+{
+    PLAY,
+    STOP_ALL,
+    PLAY_MUSIC,
+    STOP_MUSIC
+};
+
+//Sent from the game thread to the mix thread through the command ring
+struct AudioCommand
+{
+    AudioCommandType type = AudioCommandType::PLAY;
+    const SoundEffect *effect = nullptr;
+    AudioFileStream *music = nullptr;
+    MixGains gains;
+    Uint64 triggerNS = 0;
+};
+
+//Where a triggered sound's first sample sits in the output ring. The
+//callback measures latency when its reads pass outputPos.
+struct LatencyMarker
+{
+    size_t outputPos = 0;
+    Uint64 triggerNS = 0;
+};
+
+//A music stream the mix thread may still be reading until it has applied
+//the command that replaced it
+struct RetiredMusic
+{
+    AudioFileStream *stream = nullptr;
+    Uint64 command = 0;
+};
+
+struct AudioEngine
+{
+    SDL_AudioDeviceID device = 0;
+    SDL_AudioStream *stream = nullptr;
+    //Voices and music are summed in float (mixSpec) and leave the mixer as
+    //S16 (outputSpec), which is what the ring carries
+    SDL_AudioSpec mixSpec;
+    SDL_AudioSpec outputSpec;
+    int frameBytes = 0;
+    int deviceFrames = 0;
+    int mixAheadFrames = 0;
+
+    //Mix thread produces into output, the stream callback drains it
+    AudioRingBuffer output;
+    AudioRingBuffer commands;
+    AudioRingBuffer latencyMarkers;     //mix thread to callback
+    AudioLatencyWindow latency;
+    SDL_Thread *mixThread = nullptr;
+    SDL_Semaphore *mixWake = nullptr;     //game thread to mix thread
+    std::atomic<bool> drained{false};     //callback to mix thread
+    Sint32 mixPollMS = MixWakeTimeoutMS;
+    std::atomic<bool> mixRunning{false};
+    std::atomic<int> activeVoices{0};
+    Uint64 commandsSent = 0;
+    std::atomic<Uint64> commandsApplied{0};
+
+    //Effects are published to the mix thread by pointer. A replaced effect
+    //is retired rather than freed since voices may still be playing it.
+    std::atomic<const SoundEffect*> effects[MaxSoundEffects] = {};
+    std::vector<std::string> effectNames;
+    std::vector<SoundEffect*> ownedEffects;
+
+    //Long tracks stream from disk, one at a time
+    AudioFileStream *currentMusic = nullptr;
+    std::vector<RetiredMusic> retiredMusic;
+
+    //Mix thread only
+    std::vector<AudioVoice> voices;
+    AudioFileStream *music = nullptr;
+    MixGains musicGains;
+    float mixBuffer[MixBlockFrames * MaxMixChannels];
+    float musicBuffer[MixBlockFrames * MaxMixChannels];
+    Sint16 outputBlock[MixBlockFrames * MaxMixChannels];
+    //Audio thread only
+    Sint16 callbackBuffer[MixBlockFrames * MaxMixChannels];
+};
+
+static AudioEngine audioEngine;
+
+static void mixVoice(AudioVoice &voice, float *out, int frames, int channels)
+{
+    const SoundEffect &effect = *voice.effect;
+    int count = std::min(frames, effect.frames - voice.position);
+    const Sint16 *in = effect.samples.data() + static_cast<size_t>(voice.position) * effect.channels;
+    mixVoiceS16(out, channels, in, effect.channels, count, voice.gains);
+    voice.position += count;
+}
+
+static void applyAudioCommands(AudioEngine &engine)
+{
+    AudioCommand command;
+    while (getAudioRingQueued(engine.commands) >= sizeof(command)) {
+        readAudioRing(engine.commands, &command, sizeof(command));
+        switch (command.type) {
+            case AudioCommandType::PLAY: {
+                AudioVoice voice;
+                voice.effect = command.effect;
+                voice.gains = command.gains;
+                engine.voices.push_back(voice);
+
+                //The voice starts with the next block written to the ring
+                LatencyMarker marker;
+                marker.outputPos = engine.output.writePos.load(std::memory_order_relaxed);
+                marker.triggerNS = command.triggerNS;
+                writeAudioRingRecord(engine.latencyMarkers, &marker, sizeof(marker));
+                break;
+            }
+            case AudioCommandType::STOP_ALL:
+                engine.voices.clear();
+                break;
+            case AudioCommandType::PLAY_MUSIC:
+                engine.music = command.music;
+                engine.musicGains = command.gains;
+                break;
+            case AudioCommandType::STOP_MUSIC:
+                engine.music = nullptr;
+                break;
+        }
+        engine.commandsApplied.fetch_add(1, std::memory_order_release);
+    }
+}
+
+static void mixBlock(AudioEngine &engine, int frames)
+{
+    int channels = engine.mixSpec.channels;
+    std::fill(engine.mixBuffer, engine.mixBuffer + frames * channels, 0.0f);
+
+    for (size_t i = 0; i < engine.voices.size();) {
+        AudioVoice &voice = engine.voices[i];
+        mixVoice(voice, engine.mixBuffer, frames, channels);
+        if (voice.position >= voice.effect->frames) {
+            //Order doesn't matter, swap the finished voice out
+            voice = engine.voices.back();
+            engine.voices.pop_back();
+        } else {
+            ++i;
+        }
+    }
+
+    if (engine.music) {
+        int got = readAudioFileStream(*engine.music, engine.musicBuffer, frames);
+        mixVoiceF32(engine.mixBuffer, channels, engine.musicBuffer, channels, got, engine.musicGains);
+        if (isAudioFileStreamFinished(*engine.music)) {
+            engine.music = nullptr;
+        }
+    }
+    mixdownToS16(engine.outputBlock, engine.mixBuffer, frames * channels, EngineClip);
+    writeAudioRing(engine.output, engine.outputBlock, static_cast<size_t>(frames) * engine.frameBytes);
+}
+
+//Keeps the output ring mixAheadFrames ahead of the device. Woken by game
+//thread commands or the poll timeout, and goes round again straight away
+//when the callback drained while it was mixing, so a stalled game thread
+//never starves the device.
+static int audioMixThread(void *data)
+{
+    AudioEngine &engine = *static_cast<AudioEngine*>(data);
+    size_t aheadBytes = static_cast<size_t>(engine.mixAheadFrames) * engine.frameBytes;
+
+    while (engine.mixRunning.load(std::memory_order_acquire)) {
+        applyAudioCommands(engine);
+        size_t queued = getAudioRingQueued(engine.output);
+        while (queued < aheadBytes) {
+            size_t room = std::min(aheadBytes - queued, getAudioRingFree(engine.output));
+            int frames = std::min(static_cast<int>(room / engine.frameBytes), MixBlockFrames);
+            if (frames <= 0) break;
+            mixBlock(engine, frames);
+            queued += static_cast<size_t>(frames) * engine.frameBytes;
+        }
+        engine.activeVoices.store(static_cast<int>(engine.voices.size()), std::memory_order_relaxed);
+        if (!engine.drained.exchange(false, std::memory_order_acq_rel)) {
+            SDL_WaitSemaphoreTimeout(engine.mixWake, engine.mixPollMS);
+        }
+    }
+    return 0;
+}
+
+//Runs on SDL's audio thread whenever the device wants more data. Only
+//copies out of the ring; anything missing is played as silence. Takes no
+//lock of its own and allocates nothing.
+static void SDLCALL drainAudioEngine(void *userdata, SDL_AudioStream *stream, int additionalAmount, int totalAmount)
+{
+    (void)totalAmount;
+    AudioEngine &engine = *static_cast<AudioEngine*>(userdata);
+    int blockBytes = MixBlockFrames * engine.frameBytes;
+    Uint8 *buffer = reinterpret_cast<Uint8*>(engine.callbackBuffer);
+
+    while (additionalAmount > 0) {
+        int bytes = std::min(additionalAmount, blockBytes);
+        size_t got = readAudioRing(engine.output, buffer, static_cast<size_t>(bytes));
+        std::fill(buffer + got, buffer + bytes, 0);
+        //SDL holds the stream's lock around this callback already. The
+        //queue takes its chunks from a pool it recycles, so this only
+        //allocates while the pool grows over the first few callbacks.
+        SDL_PutAudioStreamData(stream, buffer, bytes);
+        additionalAmount -= bytes;
+    }
+
+    //Sounds whose first sample was just handed to the device
+    size_t accepted = engine.output.readPos.load(std::memory_order_relaxed);
+    Uint64 nowNS = SDL_GetTicksNS();
+    LatencyMarker marker;
+    while (peekAudioRing(engine.latencyMarkers, &marker, sizeof(marker)) == sizeof(marker) &&
+           static_cast<std::ptrdiff_t>(accepted - marker.outputPos) > 0) {
+        recordAudioLatency(engine.latency, marker.triggerNS, nowNS);
+        discardAudioRing(engine.latencyMarkers, sizeof(marker));
+    }
+    engine.drained.store(true, std::memory_order_release);
+}
+
+bool initAudioEngine()
+{
+    if (audioEngine.device) return true;
+
+    if (!SDL_WasInit(SDL_INIT_AUDIO) && !SDL_InitSubSystem(SDL_INIT_AUDIO)) {
+        SDL_Log("Failed to initialize audio: %s", SDL_GetError());
+        return false;
+    }
+
+    //Normal priority, so SDL_AUDIO_DEVICE_SAMPLE_FRAMES in the environment
+    //still wins
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, std::to_string(DeviceSampleFrames).c_str());
+    audioEngine.device = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, nullptr);
+    if (!audioEngine.device) {
+        SDL_Log("Failed to open audio device: %s", SDL_GetError());
+        return false;
+    }
+
+    //Mix at the device's own rate and layout so effects are converted once
+    //at load time and the stream only changes sample format
+    SDL_AudioSpec deviceSpec;
+    if (!SDL_GetAudioDeviceFormat(audioEngine.device, &deviceSpec, &audioEngine.deviceFrames)) {
+        SDL_Log("Failed to query audio device format: %s", SDL_GetError());
+        shutdownAudioEngine();
+        return false;
+    }
+    audioEngine.mixSpec.format = SDL_AUDIO_F32;
+    audioEngine.mixSpec.channels = std::min(deviceSpec.channels, MaxMixChannels);
+    audioEngine.mixSpec.freq = deviceSpec.freq;
+    audioEngine.outputSpec = audioEngine.mixSpec;
+    audioEngine.outputSpec.format = SDL_AUDIO_S16;
+    audioEngine.frameBytes = static_cast<int>(sizeof(Sint16)) * audioEngine.outputSpec.channels;
+
+    audioEngine.mixAheadFrames = std::max(MinMixAheadFrames, audioEngine.deviceFrames);
+    const char *ahead = SDL_getenv("ATARAXIA_AUDIO_MIX_AHEAD");
+    if (ahead && SDL_atoi(ahead) > 0) {
+        audioEngine.mixAheadFrames = SDL_atoi(ahead);
+    }
+    size_t ringFrames = static_cast<size_t>(audioEngine.mixAheadFrames) * MixRingAheadMultiple;
+    //Half the mix-ahead, so two polls fit in the time the device takes to play it
+    Sint32 aheadMS = static_cast<Sint32>(1000LL * audioEngine.mixAheadFrames / audioEngine.mixSpec.freq);
+    audioEngine.mixPollMS = std::max<Sint32>(1, std::min(MixWakeTimeoutMS, aheadMS / 2));
+
+    if (!createAudioRing(audioEngine.output, ringFrames * audioEngine.frameBytes) ||
+        !createAudioRing(audioEngine.commands, MaxPendingCommands * sizeof(AudioCommand)) ||
+        !createAudioRing(audioEngine.latencyMarkers, MaxPendingCommands * sizeof(LatencyMarker))) {
+        shutdownAudioEngine();
+        return false;
+    }
+    audioEngine.voices.reserve(InitialVoiceCapacity);
+
+    audioEngine.mixWake = SDL_CreateSemaphore(0);
+    audioEngine.mixRunning = true;
+    audioEngine.mixThread = audioEngine.mixWake ?
+        SDL_CreateThread(audioMixThread, "AudioMix", &audioEngine) : nullptr;
+    if (!audioEngine.mixThread) {
+        SDL_Log("Failed to start audio mix thread: %s", SDL_GetError());
+        audioEngine.mixRunning = false;
+        shutdownAudioEngine();
+        return false;
+    }
+
+    audioEngine.stream = SDL_CreateAudioStream(&audioEngine.outputSpec, &deviceSpec);
+    if (!audioEngine.stream ||
+        !SDL_SetAudioStreamGetCallback(audioEngine.stream, drainAudioEngine, &audioEngine) ||
+        !SDL_BindAudioStream(audioEngine.device, audioEngine.stream)) {
+        SDL_Log("Failed to set up audio engine stream: %s", SDL_GetError());
+        shutdownAudioEngine();
+        return false;
+    }
+
+    SDL_Log("Audio engine: %d Hz, %d channels, %s mixer, %d frame device buffer, mixing %d frames ahead",
+            audioEngine.mixSpec.freq, audioEngine.mixSpec.channels, getAudioMixKernelName(),
+            audioEngine.deviceFrames, audioEngine.mixAheadFrames);
+    return true;
+}
+
+void shutdownAudioEngine()
+{
+    //Unbinding first guarantees the callback is no longer running
+    if (audioEngine.stream) {
+        SDL_DestroyAudioStream(audioEngine.stream);
+        audioEngine.stream = nullptr;
+    }
+    if (audioEngine.mixThread) {
+        audioEngine.mixRunning = false;
+        SDL_SignalSemaphore(audioEngine.mixWake);
+        SDL_WaitThread(audioEngine.mixThread, nullptr);
+        audioEngine.mixThread = nullptr;
+    }
+    if (audioEngine.mixWake) {
+        SDL_DestroySemaphore(audioEngine.mixWake);
+        audioEngine.mixWake = nullptr;
+    }
+    if (audioEngine.device) {
+        SDL_CloseAudioDevice(audioEngine.device);
+        audioEngine.device = 0;
+    }
+    //Nothing reads the streams once the mix thread is gone
+    for (RetiredMusic &retired : audioEngine.retiredMusic) {
+        closeAudioFileStream(*retired.stream);
+        delete retired.stream;
+    }
+    audioEngine.retiredMusic.clear();
+    if (audioEngine.currentMusic) {
+        closeAudioFileStream(*audioEngine.currentMusic);
+        delete audioEngine.currentMusic;
+        audioEngine.currentMusic = nullptr;
+    }
+    audioEngine.music = nullptr;
+    audioEngine.commandsSent = 0;
+    audioEngine.commandsApplied = 0;
+    destroyAudioRing(audioEngine.output);
+    destroyAudioRing(audioEngine.commands);
+    destroyAudioRing(audioEngine.latencyMarkers);
+    resetAudioLatency(audioEngine.latency);
+    audioEngine.voices.clear();
+    audioEngine.activeVoices = 0;
+
+    for (int i = 0; i < MaxSoundEffects; ++i) {
+        audioEngine.effects[i] = nullptr;
+    }
+    for (SoundEffect *effect : audioEngine.ownedEffects) {
+        delete effect;
+    }
+    audioEngine.ownedEffects.clear();
+    audioEngine.effectNames.clear();
+}
+
+int findSoundEffect(const std::string &name)
+{
+    for (size_t i = 0; i < audioEngine.effectNames.size(); ++i) {
+        if (audioEngine.effectNames[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+int loadSoundEffect(const std::string &name, const std::string &path)
+{
+    if (!audioEngine.device) return -1;
+
+    int id = findSoundEffect(name);
+    if (id < 0 && static_cast<int>(audioEngine.effectNames.size()) >= MaxSoundEffects) {
+        SDL_Log("Cannot load sound effect %s, the bank holds %d", name.c_str(), MaxSoundEffects);
+        return -1;
+    }
+
+    //Compressed effects are decoded once here, the bank is the cache
+    SDL_AudioSpec fileSpec;
+    Uint8 *fileData = nullptr;
+    Uint32 fileBytes = 0;
+    std::vector<Uint8> decoded;
+    if (isWavPath(path)) {
+        if (!SDL_LoadWAV(path.c_str(), &fileSpec, &fileData, &fileBytes)) {
+            SDL_Log("Failed to load sound effect %s: %s", path.c_str(), SDL_GetError());
+            return -1;
+        }
+    } else {
+        if (!decodeAudioFile(path, fileSpec, decoded)) return -1;
+        fileData = decoded.data();
+        fileBytes = static_cast<Uint32>(decoded.size());
+    }
+
+    //Mono stays mono so the mixer can pan it
+    SDL_AudioSpec effectSpec = audioEngine.outputSpec;
+    if (fileSpec.channels == 1) effectSpec.channels = 1;
+
+    Uint8 *converted = nullptr;
+    int convertedBytes = 0;
+    bool ok = SDL_ConvertAudioSamples(&fileSpec, fileData, static_cast<int>(fileBytes),
+                                      &effectSpec, &converted, &convertedBytes);
+    if (decoded.empty()) SDL_free(fileData);
+    if (!ok) {
+        SDL_Log("Failed to convert sound effect %s: %s", path.c_str(), SDL_GetError());
+        return -1;
+    }
+
+    SoundEffect *effect = new SoundEffect();
+    effect->samples.assign(reinterpret_cast<Sint16*>(converted),
+                           reinterpret_cast<Sint16*>(converted + convertedBytes));
+    effect->channels = effectSpec.channels;
+    effect->frames = static_cast<int>(effect->samples.size()) / effect->channels;
+    SDL_free(converted);
+    audioEngine.ownedEffects.push_back(effect);
+
+    if (id < 0) {
+        id = static_cast<int>(audioEngine.effectNames.size());
+        audioEngine.effectNames.push_back(name);
+    }
+    audioEngine.effects[id].store(effect, std::memory_order_release);
+
+    SDL_Log("Loaded sound effect %s (%d frames)", name.c_str(), effect->frames);
+    return id;
+}
+
+static bool sendAudioCommand(const AudioCommand &command)
+{
+    if (!audioEngine.mixThread) return false;
+    //The game thread is the only producer. A command that doesn't fit whole
+    //is dropped and counted in droppedCommands; half of one would misalign
+    //every command read after it.
+    bool sent = writeAudioRingRecord(audioEngine.commands, &command, sizeof(command));
+    if (sent) ++audioEngine.commandsSent;
+    SDL_SignalSemaphore(audioEngine.mixWake);
+    return sent;
+}
+
+bool playSoundEffect(int effect, float gain, float pan, Uint64 triggerNS)
+{
+    if (effect < 0 || effect >= MaxSoundEffects) return false;
+
+    AudioCommand command;
+    command.type = AudioCommandType::PLAY;
+    command.effect = audioEngine.effects[effect].load(std::memory_order_acquire);
+    command.gains = panGains(gain, pan);
+    command.triggerNS = triggerNS ? triggerNS : SDL_GetTicksNS();
+    return command.effect && sendAudioCommand(command);
+}
+
+bool playSoundEffect(const std::string &name, float gain, float pan)
+{
+    return playSoundEffect(findSoundEffect(name), gain, pan);
+}
+
+void stopAllSoundEffects()
+{
+    AudioCommand command;
+    command.type = AudioCommandType::STOP_ALL;
+    sendAudioCommand(command);
+}
+
+//Frees streams the mix thread has let go of
+static void reapRetiredMusic()
+{
+    Uint64 applied = audioEngine.commandsApplied.load(std::memory_order_acquire);
+    for (size_t i = 0; i < audioEngine.retiredMusic.size();) {
+        RetiredMusic &retired = audioEngine.retiredMusic[i];
+        if (retired.command <= applied) {
+            closeAudioFileStream(*retired.stream);
+            delete retired.stream;
+            retired = audioEngine.retiredMusic.back();
+            audioEngine.retiredMusic.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+static void retireCurrentMusic()
+{
+    if (!audioEngine.currentMusic) return;
+    RetiredMusic retired;
+    retired.stream = audioEngine.currentMusic;
+    retired.command = audioEngine.commandsSent;
+    audioEngine.retiredMusic.push_back(retired);
+    audioEngine.currentMusic = nullptr;
+}
+
+bool playMusic(const std::string &path, bool looping, float gain)
+{
+    if (!audioEngine.mixThread) return false;
+    reapRetiredMusic();
+
+    AudioFileStream *stream = new AudioFileStream();
+    if (!openAudioFileStream(*stream, path, audioEngine.mixSpec, looping)) {
+        delete stream;
+        return false;
+    }
+
+    AudioCommand command;
+    command.type = AudioCommandType::PLAY_MUSIC;
+    command.music = stream;
+    command.gains.left = gain;
+    command.gains.right = gain;
+    if (!sendAudioCommand(command)) {
+        closeAudioFileStream(*stream);
+        delete stream;
+        return false;
+    }
+    //The old track is released once the mixer has switched over
+    retireCurrentMusic();
+    audioEngine.currentMusic = stream;
+    return true;
+}
+
+void stopMusic()
+{
+    if (!audioEngine.currentMusic) return;
+
+    AudioCommand command;
+    command.type = AudioCommandType::STOP_MUSIC;
+    if (sendAudioCommand(command)) {
+        retireCurrentMusic();
+    }
+    reapRetiredMusic();
+}
+
+void seekMusic(Uint64 byteOffset)
+{
+    if (audioEngine.currentMusic) {
+        seekAudioFileStream(*audioEngine.currentMusic, byteOffset);
+    }
+}
+
+SDL_AudioDeviceID getAudioEngineDevice()
+{
+    return audioEngine.device;
+}
+
+int getActiveVoiceCount()
+{
+    return audioEngine.activeVoices.load(std::memory_order_relaxed);
+}
+
+AudioEngineStats getAudioEngineStats()
+{
+    AudioEngineStats stats;
+    stats.underruns = audioEngine.output.underruns.load(std::memory_order_relaxed);
+    stats.overruns = audioEngine.output.overruns.load(std::memory_order_relaxed);
+    stats.droppedCommands = audioEngine.commands.overruns.load(std::memory_order_relaxed);
+    stats.queuedFrames = audioEngine.frameBytes ?
+        static_cast<int>(getAudioRingQueued(audioEngine.output) / audioEngine.frameBytes) : 0;
+    return stats;
+}
+
+AudioLatencyStats getAudioEngineLatency()
+{
+    return getAudioLatencyStats(audioEngine.latency);
+}
+
+void logAudioEngineStats()
+{
+    AudioEngineStats stats = getAudioEngineStats();
+    SDL_Log("Audio engine: %llu underruns, %llu overruns, %llu dropped triggers, %d frames queued",
+            static_cast<unsigned long long>(stats.underruns),
+            static_cast<unsigned long long>(stats.overruns),
+            static_cast<unsigned long long>(stats.droppedCommands),
+            stats.queuedFrames);
+
+    AudioLatencyStats latency = getAudioEngineLatency();
+    if (latency.samples > 0) {
+        //The device still has its own buffer to play through after this
+        double deviceMS = audioEngine.mixSpec.freq > 0 ?
+            1000.0 * audioEngine.deviceFrames / audioEngine.mixSpec.freq : 0.0;
+        SDL_Log("Audio latency (input to device): p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms "
+                "over %llu sounds, %u over the %.0f ms target, +%.2f ms device buffer",
+                latency.p50MS, latency.p95MS, latency.p99MS, latency.maxMS,
+                static_cast<unsigned long long>(latency.samples), latency.overTarget,
+                AudioLatencyTargetMS, deviceMS);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef AUDIO_ENGINE_H
+#define AUDIO_ENGINE_H
+
+#include <string>
+#include <SDL3/SDL.h>
+
+#include "audioLatency.h"
+
+//One playback device opened for the life of the program, a bank of sound
+//effects decoded up front into the mix format, and a mixer that plays any
+//number of them at once. Voices are mixed on a dedicated thread into a
+//lock-free ring (see audioRingBuffer.h) that the device callback drains, so
+//a stalled game thread doesn't stall the audio. Triggering a sound only
+//queues a command, no file or device work.
+bool initAudioEngine();
+void shutdownAudioEngine();
+//The one playback device, or 0 before init. Other audio (a video's
+//soundtrack) binds its own stream here instead of opening a device.
+SDL_AudioDeviceID getAudioEngineDevice();
+
+//Loads a WAV, or decodes a compressed file (Ogg, Opus, MP3...) once, and
+//converts it to the device's rate and, unless it is mono, its channel
+//layout. Returns the effect's id, or -1 on failure. Loading a name twice
+//replaces the earlier sound.
+int loadSoundEffect(const std::string &name, const std::string &path);
+int findSoundEffect(const std::string &name);
+
+//Starts a new voice, overlapping anything already playing. pan runs from
+//-1 (left) to +1 (right). triggerNS is when the cause happened, normally an
+//SDL event timestamp, and is what input-to-audio latency is measured from;
+//0 means now.
+bool playSoundEffect(int effect, float gain = 1.0f, float pan = 0.0f, Uint64 triggerNS = 0);
+bool playSoundEffect(const std::string &name, float gain = 1.0f, float pan = 0.0f);
+void stopAllSoundEffects();
+
+//Long tracks, WAV or compressed, are streamed from disk through a small
+//read-ahead buffer instead of being decoded up front (see audioFileStream.h).
+//One track plays at a time; starting another replaces it.
+bool playMusic(const std::string &path, bool looping = true, float gain = 1.0f);
+void stopMusic();
+//Byte offset into the track's PCM data (S16 at the file's rate for
+//compressed tracks)
+void seekMusic(Uint64 byteOffset);
+
+//As of the mix thread's last pass
+int getActiveVoiceCount();
+
+struct AudioEngineStats
+{
+    Uint64 underruns = 0;           //device callbacks the mixer couldn't fully feed
+    Uint64 overruns = 0;            //mixed audio that didn't fit in the ring
+    Uint64 droppedCommands = 0;     //triggers lost to a full command ring
+    int queuedFrames = 0;
+};
+
+AudioEngineStats getAudioEngineStats();
+//From each sound's trigger to its first sample being handed to the device,
+//over the most recent sounds. The device's own buffer comes on top.
+AudioLatencyStats getAudioEngineLatency();
+void logAudioEngineStats();
+
+#endif
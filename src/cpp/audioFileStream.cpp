@@ -0,0 +1,338 @@
+#include "audioFileStream.h"
+
+#include <algorithm>
+
+//Chunk ids as they read from the file, little endian
+constexpr Uint32 RiffId = 0x46464952;   //"RIFF"
+constexpr Uint32 WaveId = 0x45564157;   //"WAVE"
+constexpr Uint32 FmtId = 0x20746d66;    //"fmt "
+constexpr Uint32 DataId = 0x61746164;   //"data"
+
+constexpr Uint16 WaveFormatPCM = 0x0001;
+constexpr Uint16 WaveFormatFloat = 0x0003;
+constexpr Uint16 WaveFormatExtensible = 0xFFFE;
+
+constexpr Sint32 StreamWakeTimeoutMS = 10;
+
+static bool wavSampleFormat(Uint16 tag, Uint16 bits, SDL_AudioFormat &format)
+{
+    if (tag == WaveFormatPCM) {
+        switch (bits) {
+            case 8: format = SDL_AUDIO_U8; return true;
+            case 16: format = SDL_AUDIO_S16LE; return true;
+            case 32: format = SDL_AUDIO_S32LE; return true;
+            default: return false;
+        }
+    }
+    if (tag == WaveFormatFloat && bits == 32) {
+        format = SDL_AUDIO_F32LE;
+        return true;
+    }
+    return false;
+}
+
+//Walks the chunk list for the format and the data chunk, leaving io at the
+//first sample
+static bool parseWavHeader(AudioFileStream &stream, const std::string &path)
+{
+    Uint32 riff = 0, riffSize = 0, wave = 0;
+    if (!SDL_ReadU32LE(stream.io, &riff) || !SDL_ReadU32LE(stream.io, &riffSize) ||
+        !SDL_ReadU32LE(stream.io, &wave) || riff != RiffId || wave != WaveId) {
+        SDL_Log("%s is not a RIFF WAVE file", path.c_str());
+        return false;
+    }
+
+    bool haveFormat = false;
+    Sint64 fileSize = SDL_GetIOSize(stream.io);
+    Uint32 id = 0, size = 0;
+    while (SDL_ReadU32LE(stream.io, &id) && SDL_ReadU32LE(stream.io, &size)) {
+        Sint64 chunkStart = SDL_TellIO(stream.io);
+        if (id == FmtId) {
+            Uint16 tag = 0, channels = 0, blockAlign = 0, bits = 0;
+            Uint32 rate = 0, byteRate = 0;
+            if (size < 16 ||
+                !SDL_ReadU16LE(stream.io, &tag) || !SDL_ReadU16LE(stream.io, &channels) ||
+                !SDL_ReadU32LE(stream.io, &rate) || !SDL_ReadU32LE(stream.io, &byteRate) ||
+                !SDL_ReadU16LE(stream.io, &blockAlign) || !SDL_ReadU16LE(stream.io, &bits)) {
+                break;
+            }
+            if (tag == WaveFormatExtensible && size >= 26) {
+                //cbSize, valid bits and channel mask come before the sub-format
+                Uint16 extra = 0;
+                Uint32 mask = 0;
+                SDL_ReadU16LE(stream.io, &extra);
+                SDL_ReadU16LE(stream.io, &extra);
+                SDL_ReadU32LE(stream.io, &mask);
+                SDL_ReadU16LE(stream.io, &tag);
+            }
+            SDL_AudioFormat format;
+            if (!wavSampleFormat(tag, bits, format) || channels == 0 || rate == 0 ||
+                blockAlign != channels * (bits / 8)) {
+                SDL_Log("%s: unsupported WAV format (tag %u, %u bits)", path.c_str(), tag, bits);
+                return false;
+            }
+            stream.fileSpec.format = format;
+            stream.fileSpec.channels = channels;
+            stream.fileSpec.freq = static_cast<int>(rate);
+            stream.blockAlign = blockAlign;
+            haveFormat = true;
+        } else if (id == DataId) {
+            if (!haveFormat) break;
+            stream.dataOffset = static_cast<Uint64>(chunkStart);
+            //Writers that never went back to patch the size leave it at the
+            //maximum, the file's end bounds it either way
+            Uint64 available = fileSize > chunkStart ? static_cast<Uint64>(fileSize - chunkStart) : 0;
+            stream.dataBytes = std::min<Uint64>(size, available);
+            stream.dataBytes -= stream.dataBytes % stream.blockAlign;
+            return true;
+        }
+        //Chunks are padded to an even size
+        if (SDL_SeekIO(stream.io, chunkStart + size + (size & 1), SDL_IO_SEEK_SET) < 0) break;
+    }
+
+    SDL_Log("%s: no %s chunk", path.c_str(), haveFormat ? "data" : "fmt");
+    return false;
+}
+
+static void readWavBlock(AudioFileStream &stream)
+{
+    if (stream.readPos >= stream.dataBytes) {
+        if (stream.looping && stream.dataBytes > 0) {
+            SDL_SeekIO(stream.io, static_cast<Sint64>(stream.dataOffset), SDL_IO_SEEK_SET);
+            stream.readPos = 0;
+        } else {
+            SDL_FlushAudioStream(stream.converter);
+            stream.endOfData = true;
+            return;
+        }
+    }
+
+    Uint64 remaining = stream.dataBytes - stream.readPos;
+    size_t want = static_cast<size_t>(std::min<Uint64>(remaining, StreamReadBlockBytes));
+    want -= want % stream.blockAlign;
+    size_t got = SDL_ReadIO(stream.io, stream.fileBlock, want);
+    got -= got % stream.blockAlign;
+    if (got == 0) {
+        //Truncated file, treat what was read as the whole track
+        SDL_Log("WAV stream: read failed at byte %llu: %s",
+                static_cast<unsigned long long>(stream.readPos), SDL_GetError());
+        stream.dataBytes = stream.readPos;
+        return;
+    }
+    SDL_PutAudioStreamData(stream.converter, stream.fileBlock, static_cast<int>(got));
+    stream.readPos += got;
+}
+
+//Compressed files hand over whatever one packet decodes to
+static void readDecodedBlock(AudioFileStream &stream)
+{
+    int bytes = decodeAudioChunk(stream.decoder);
+    if (bytes > 0) {
+        SDL_PutAudioStreamData(stream.converter, stream.decoder.pcm.data(), bytes);
+        stream.readPos += static_cast<Uint64>(bytes);
+        return;
+    }
+    //A file that ends before producing anything would otherwise loop forever
+    if (bytes == 0 && stream.looping && stream.readPos > 0 && seekAudioDecoder(stream.decoder, 0)) {
+        stream.readPos = 0;
+        return;
+    }
+    SDL_FlushAudioStream(stream.converter);
+    stream.endOfData = true;
+}
+
+static void readSourceBlock(AudioFileStream &stream)
+{
+    if (stream.compressed) {
+        readDecodedBlock(stream);
+    } else {
+        readWavBlock(stream);
+    }
+}
+
+static void applySeek(AudioFileStream &stream, Sint64 byteOffset)
+{
+    Uint64 offset = static_cast<Uint64>(byteOffset);
+    //Compressed lengths are only an estimate, let the decoder find the end
+    if (!stream.compressed || stream.dataBytes > 0) {
+        offset = std::min<Uint64>(offset, stream.dataBytes);
+    }
+    offset -= offset % stream.blockAlign;
+    if (stream.compressed) {
+        seekAudioDecoder(stream.decoder, offset);
+    } else {
+        SDL_SeekIO(stream.io, static_cast<Sint64>(stream.dataOffset + offset), SDL_IO_SEEK_SET);
+    }
+    stream.readPos = offset;
+    stream.endOfData = false;
+    SDL_ClearAudioStream(stream.converter);
+
+    //Everything written from here on belongs to the new position
+    stream.epochWritePos.store(stream.ring.writePos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    stream.epoch.fetch_add(1, std::memory_order_release);
+    stream.finished.store(false, std::memory_order_release);
+}
+
+//Tops up the read-ahead. Returns true when anything was added.
+static bool fillAudioFileStream(AudioFileStream &stream)
+{
+    int chunkBytes = StreamConvertFrames * stream.outFrameBytes;
+    bool produced = false;
+
+    while (getAudioRingFree(stream.ring) >= static_cast<size_t>(chunkBytes)) {
+        int available = SDL_GetAudioStreamAvailable(stream.converter);
+        if (available < chunkBytes && !stream.endOfData) {
+            readSourceBlock(stream);
+            continue;
+        }
+        if (available <= 0) {
+            stream.finished.store(true, std::memory_order_release);
+            break;
+        }
+        int got = SDL_GetAudioStreamData(stream.converter, stream.convertBlock, chunkBytes);
+        if (got <= 0) break;
+        writeAudioRing(stream.ring, stream.convertBlock, static_cast<size_t>(got));
+        produced = true;
+    }
+    return produced;
+}
+
+static int audioFileStreamThread(void *data)
+{
+    AudioFileStream &stream = *static_cast<AudioFileStream*>(data);
+
+    while (stream.running.load(std::memory_order_acquire)) {
+        Sint64 seek = stream.seekRequest.exchange(-1, std::memory_order_acq_rel);
+        if (seek >= 0) {
+            applySeek(stream, seek);
+        }
+        if (!fillAudioFileStream(stream)) {
+            SDL_WaitSemaphoreTimeout(stream.wake, StreamWakeTimeoutMS);
+        }
+    }
+    return 0;
+}
+
+bool openAudioFileStream(AudioFileStream &stream, const std::string &path, const SDL_AudioSpec &outSpec, bool looping)
+{
+    if (outSpec.format != SDL_AUDIO_F32 || outSpec.channels > StreamMaxChannels) {
+        SDL_Log("Audio stream: output must be float with at most %d channels", StreamMaxChannels);
+        return false;
+    }
+
+    stream.compressed = !isWavPath(path);
+    if (stream.compressed) {
+        if (!openAudioDecoder(stream.decoder, path)) return false;
+        stream.fileSpec = stream.decoder.spec;
+        stream.blockAlign = stream.decoder.frameBytes;
+        stream.dataBytes = stream.decoder.estimatedBytes;
+    } else {
+        stream.io = SDL_IOFromFile(path.c_str(), "rb");
+        if (!stream.io) {
+            SDL_Log("Failed to open %s: %s", path.c_str(), SDL_GetError());
+            return false;
+        }
+        if (!parseWavHeader(stream, path)) {
+            closeAudioFileStream(stream);
+            return false;
+        }
+    }
+
+    stream.outSpec = outSpec;
+    stream.outFrameBytes = static_cast<int>(sizeof(float)) * outSpec.channels;
+    stream.looping = looping;
+    stream.readPos = 0;
+    stream.endOfData = false;
+    stream.converter = SDL_CreateAudioStream(&stream.fileSpec, &stream.outSpec);
+    if (!stream.converter ||
+        !createAudioRing(stream.ring, static_cast<size_t>(StreamReadAheadFrames) * stream.outFrameBytes)) {
+        SDL_Log("Failed to set up audio stream for %s: %s", path.c_str(), SDL_GetError());
+        closeAudioFileStream(stream);
+        return false;
+    }
+
+    //The first read-ahead happens here so playback starts with a full ring
+    fillAudioFileStream(stream);
+
+    stream.wake = SDL_CreateSemaphore(0);
+    stream.running = true;
+    stream.thread = stream.wake ? SDL_CreateThread(audioFileStreamThread, "AudioFileStream", &stream) : nullptr;
+    if (!stream.thread) {
+        SDL_Log("Failed to start audio stream worker: %s", SDL_GetError());
+        stream.running = false;
+        closeAudioFileStream(stream);
+        return false;
+    }
+
+    SDL_Log("Streaming %s: %s, %d Hz, %d channels, ~%llu bytes of PCM, %zu bytes resident",
+            path.c_str(), stream.compressed ? stream.decoder.codecCtx->codec->name : "wav",
+            stream.fileSpec.freq, stream.fileSpec.channels,
+            static_cast<unsigned long long>(stream.dataBytes), getAudioFileStreamResidentBytes(stream));
+    return true;
+}
+
+void closeAudioFileStream(AudioFileStream &stream)
+{
+    if (stream.thread) {
+        stream.running = false;
+        SDL_SignalSemaphore(stream.wake);
+        SDL_WaitThread(stream.thread, nullptr);
+        stream.thread = nullptr;
+    }
+    if (stream.wake) {
+        SDL_DestroySemaphore(stream.wake);
+        stream.wake = nullptr;
+    }
+    if (stream.converter) {
+        SDL_DestroyAudioStream(stream.converter);
+        stream.converter = nullptr;
+    }
+    if (stream.io) {
+        SDL_CloseIO(stream.io);
+        stream.io = nullptr;
+    }
+    closeAudioDecoder(stream.decoder);
+    destroyAudioRing(stream.ring);
+}
+
+void seekAudioFileStream(AudioFileStream &stream, Uint64 byteOffset)
+{
+    stream.seekRequest.store(static_cast<Sint64>(byteOffset), std::memory_order_release);
+    SDL_SignalSemaphore(stream.wake);
+}
+
+int readAudioFileStream(AudioFileStream &stream, float *dst, int frames)
+{
+    Uint32 epoch = stream.epoch.load(std::memory_order_acquire);
+    if (epoch != stream.consumerEpoch) {
+        //Skip read-ahead from before the seek. If some of the new data was
+        //already read this is a no-op.
+        stream.consumerEpoch = epoch;
+        size_t start = stream.epochWritePos.load(std::memory_order_relaxed);
+        size_t read = stream.ring.readPos.load(std::memory_order_relaxed);
+        if (static_cast<std::ptrdiff_t>(start - read) > 0) {
+            discardAudioRing(stream.ring, start - read);
+        }
+    }
+
+    size_t bytes = static_cast<size_t>(frames) * stream.outFrameBytes;
+    //The tail of a finished track isn't an underrun
+    if (stream.finished.load(std::memory_order_acquire)) {
+        bytes = std::min(bytes, getAudioRingQueued(stream.ring));
+    }
+    size_t got = readAudioRing(stream.ring, dst, bytes);
+    SDL_SignalSemaphore(stream.wake);
+    return static_cast<int>(got / stream.outFrameBytes);
+}
+
+bool isAudioFileStreamFinished(const AudioFileStream &stream)
+{
+    return stream.finished.load(std::memory_order_acquire) &&
+           stream.seekRequest.load(std::memory_order_acquire) < 0 &&
+           getAudioRingQueued(stream.ring) == 0;
+}
+
+size_t getAudioFileStreamResidentBytes(const AudioFileStream &stream)
+{
+    return sizeof(AudioFileStream) + stream.ring.capacity + stream.decoder.pcm.capacity();
+}
@@ -0,0 +1,75 @@
+#ifndef AUDIO_FILE_STREAM_H
+#define AUDIO_FILE_STREAM_H
+
+#include <atomic>
+#include <string>
+#include <SDL3/SDL.h>
+
+#include "audioRingBuffer.h"
+#include "audioDecoder.h"
+
+//Bytes read from a WAV file per step, and frames converted per step
+constexpr int StreamReadBlockBytes = 16 * 1024;
+constexpr int StreamConvertFrames = 1024;
+constexpr int StreamMaxChannels = 8;
+//Converted audio kept ready ahead of the mixer, about a third of a second
+constexpr int StreamReadAheadFrames = 16384;
+
+//Plays an audio file of any length from a small fixed amount of memory. WAV
+//files have their RIFF header parsed once and the data chunk read in blocks;
+//anything else (Ogg, Opus, MP3...) is decoded a packet at a time through
+//libav. Either way a worker converts to the output format and keeps a ring
+//of read-ahead filled for the consumer (the mix thread).
+struct AudioFileStream
+{
+    bool compressed = false;
+    SDL_IOStream *io = nullptr;     //WAV source
+    AudioDecoder decoder;           //compressed source, worker only once started
+    SDL_AudioSpec fileSpec;
+    SDL_AudioSpec outSpec;
+    int outFrameBytes = 0;
+    Uint64 dataOffset = 0;          //file offset of the first sample
+    Uint64 dataBytes = 0;           //estimated from the duration when compressed
+    int blockAlign = 0;
+    bool looping = false;
+
+    //Worker only
+    SDL_AudioStream *converter = nullptr;
+    Uint64 readPos = 0;             //bytes of source PCM consumed
+    bool endOfData = false;
+    Uint8 fileBlock[StreamReadBlockBytes];
+    float convertBlock[StreamConvertFrames * StreamMaxChannels];
+
+    AudioRingBuffer ring;
+    SDL_Thread *thread = nullptr;
+    SDL_Semaphore *wake = nullptr;
+    std::atomic<bool> running{false};
+    std::atomic<bool> finished{false};
+
+    //A seek bumps epoch and records where the new position's data starts in
+    //the ring, so the consumer can drop what was read ahead before it
+    std::atomic<Sint64> seekRequest{-1};
+    std::atomic<Uint32> epoch{0};
+    std::atomic<size_t> epochWritePos{0};
+    Uint32 consumerEpoch = 0;
+};
+
+//Opens the source, prefills the read-ahead and starts the worker. WAV files
+//may hold integer PCM (8, 16, 32 bit) or 32-bit float.
+bool openAudioFileStream(AudioFileStream &stream, const std::string &path, const SDL_AudioSpec &outSpec, bool looping);
+void closeAudioFileStream(AudioFileStream &stream);
+
+//Restarts from byteOffset into the source PCM (the WAV data chunk, or the
+//decoder's S16 output), rounded down to a whole frame
+void seekAudioFileStream(AudioFileStream &stream, Uint64 byteOffset);
+
+//Consumer side, never blocks. Returns the frames copied into dst, fewer than
+//asked for when the read-ahead ran dry or the track ended.
+int readAudioFileStream(AudioFileStream &stream, float *dst, int frames);
+//True once a non-looping track has played to the end
+bool isAudioFileStreamFinished(const AudioFileStream &stream);
+
+//Memory the stream keeps resident, independent of the track length
+size_t getAudioFileStreamResidentBytes(const AudioFileStream &stream);
+
+#endif
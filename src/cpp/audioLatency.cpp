@@ -0,0 +1,53 @@
+#include "audioLatency.h"
+
+#include <algorithm>
+#include <vector>
+
+void recordAudioLatency(AudioLatencyWindow &window, Uint64 triggerNS, Uint64 nowNS)
+{
+    Uint64 latencyNS = nowNS > triggerNS ? nowNS - triggerNS : 0;
+    Uint32 latencyUS = static_cast<Uint32>(std::min<Uint64>(latencyNS / 1000, SDL_MAX_UINT32));
+
+    //Only the audio thread records, so the slot can't be claimed twice
+    Uint64 index = window.count.load(std::memory_order_relaxed);
+    window.samplesUS[index % AudioLatencyWindowSize].store(latencyUS, std::memory_order_relaxed);
+    window.count.store(index + 1, std::memory_order_release);
+    if (latencyUS > AudioLatencyTargetMS * 1000.0) {
+        window.overTarget.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static double percentileMS(std::vector<Uint32> &samples, double fraction)
+{
+    size_t index = static_cast<size_t>(fraction * (samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index] / 1000.0;
+}
+
+AudioLatencyStats getAudioLatencyStats(const AudioLatencyWindow &window)
+{
+    AudioLatencyStats stats;
+    stats.samples = window.count.load(std::memory_order_acquire);
+    stats.overTarget = window.overTarget.load(std::memory_order_relaxed);
+    size_t filled = static_cast<size_t>(std::min<Uint64>(stats.samples, AudioLatencyWindowSize));
+    if (filled == 0) return stats;
+
+    std::vector<Uint32> samples(filled);
+    for (size_t i = 0; i < filled; ++i) {
+        samples[i] = window.samplesUS[i].load(std::memory_order_relaxed);
+    }
+    stats.p50MS = percentileMS(samples, 0.50);
+    stats.p95MS = percentileMS(samples, 0.95);
+    stats.p99MS = percentileMS(samples, 0.99);
+    stats.maxMS = percentileMS(samples, 1.0);
+    return stats;
+}
+
+void resetAudioLatency(AudioLatencyWindow &window)
+{
+    for (std::atomic<Uint32> &sample : window.samplesUS) {
+        sample.store(0, std::memory_order_relaxed);
+    }
+    window.count.store(0, std::memory_order_relaxed);
+    window.overTarget.store(0, std::memory_order_relaxed);
+}
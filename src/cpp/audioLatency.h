@@ -0,0 +1,36 @@
+#ifndef AUDIO_LATENCY_H
+#define AUDIO_LATENCY_H
+
+#include <atomic>
+#include <SDL3/SDL.h>
+
+//Input-to-audio latency we hold ourselves to
+constexpr double AudioLatencyTargetMS = 20.0;
+constexpr int AudioLatencyWindowSize = 256;
+
+//The most recent AudioLatencyWindowSize measurements. Recording is a couple
+//of relaxed atomic stores, safe from the audio callback; reading takes a
+//snapshot that may mix in a sample or two being written concurrently.
+struct AudioLatencyWindow
+{
+    std::atomic<Uint32> samplesUS[AudioLatencyWindowSize] = {};
+    std::atomic<Uint64> count{0};
+    std::atomic<Uint32> overTarget{0};
+};
+
+struct AudioLatencyStats
+{
+    Uint64 samples = 0;         //measured since startup, the percentiles cover the window
+    Uint32 overTarget = 0;
+    double p50MS = 0.0;
+    double p95MS = 0.0;
+    double p99MS = 0.0;
+    double maxMS = 0.0;
+};
+
+//One measurement, from the trigger's timestamp to now. Lock and allocation free.
+void recordAudioLatency(AudioLatencyWindow &window, Uint64 triggerNS, Uint64 nowNS);
+AudioLatencyStats getAudioLatencyStats(const AudioLatencyWindow &window);
+void resetAudioLatency(AudioLatencyWindow &window);
+
+#endif
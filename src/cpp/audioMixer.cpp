@@ -0,0 +1,468 @@
+#include "audioMixer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AUDIO_MIXER_X86 1
+#include <immintrin.h>
+#endif
+//The mixdown rounds with vcvtnq, which only AArch64 has
+#if defined(__aarch64__)
+#define AUDIO_MIXER_NEON 1
+#include <arm_neon.h>
+#endif
+
+//Every kernel has to round the same way as the scalar reference, so the
+//compiler may not fuse a*b+c into an FMA in one and not the others. The
+//Makefile also builds this file with -ffp-contract=off for GCC.
+#ifdef __clang__
+#pragma clang fp contract(off)
+#endif
+
+constexpr float S16Scale = 1.0f / 32768.0f;
+//The soft clip curve reaches exactly +-1 here and stays there
+constexpr float SoftClipLimit = 3.0f;
+
+//Stereo output only; other layouts always take the scalar path
+typedef void (*MixS16Func)(float *dst, const Sint16 *src, bool monoSource, int frames, float left, float right);
+typedef void (*MixF32Func)(float *dst, const float *src, bool monoSource, int frames, float left, float right);
+typedef void (*MixdownFunc)(Sint16 *dst, const float *src, int count, MixClip clip);
+
+MixGains panGains(float gain, float pan)
+{
+    pan = std::min(1.0f, std::max(-1.0f, pan));
+    MixGains gains;
+    gains.left = gain * std::min(1.0f, 1.0f - pan);
+    gains.right = gain * std::min(1.0f, 1.0f + pan);
+    return gains;
+}
+
+static inline float channelGain(int channel, float left, float right)
+{
+    if (channel == 0) return left;
+    if (channel == 1) return right;
+    return (left + right) * 0.5f;
+}
+
+//Frames [frame, frames) of any layout. The SIMD kernels finish their blocks
+//with these, so the arithmetic must stay the same as theirs: one multiply
+//and one add per sample, no fused multiply-add.
+template <typename Sample>
+static void mixFramesScalar(float *dst, int dstChannels, const Sample *src, int srcChannels,
+                            int frame, int frames, float left, float right, float scale)
+{
+    float gains[8];
+    int channels = std::min(dstChannels, 8);
+    for (int c = 0; c < channels; ++c) {
+        gains[c] = channelGain(c, left, right) * scale;
+    }
+    bool mono = srcChannels == 1;
+    for (; frame < frames; ++frame) {
+        float *out = dst + static_cast<size_t>(frame) * dstChannels;
+        const Sample *in = src + static_cast<size_t>(frame) * srcChannels;
+        for (int c = 0; c < channels; ++c) {
+            out[c] += static_cast<float>(in[mono ? 0 : c]) * gains[c];
+        }
+    }
+}
+
+static void mixS16Scalar(float *dst, const Sint16 *src, bool monoSource, int frames, float left, float right)
+{
+    mixFramesScalar(dst, 2, src, monoSource ? 1 : 2, 0, frames, left, right, S16Scale);
+}
+
+static void mixF32Scalar(float *dst, const float *src, bool monoSource, int frames, float left, float right)
+{
+    mixFramesScalar(dst, 2, src, monoSource ? 1 : 2, 0, frames, left, right, 1.0f);
+}
+
+static inline float clipSample(float sample, MixClip clip)
+{
+    if (clip == MixClip::SOFT) {
+        //Pade approximation of tanh, slope 1 at zero and flat at the limit
+        float x = std::min(SoftClipLimit, std::max(-SoftClipLimit, sample));
+        float x2 = x * x;
+        return x * (27.0f + x2) / (27.0f + 9.0f * x2) * 32767.0f;
+    }
+    return std::min(32767.0f, std::max(-32768.0f, sample * 32768.0f));
+}
+
+static void mixdownSamplesScalar(Sint16 *dst, const float *src, int i, int count, MixClip clip)
+{
+    for (; i < count; ++i) {
+        //Round to nearest even, like the SIMD conversions
+        dst[i] = static_cast<Sint16>(std::lrint(clipSample(src[i], clip)));
+    }
+}
+
+static void mixdownScalar(Sint16 *dst, const float *src, int count, MixClip clip)
+{
+    mixdownSamplesScalar(dst, src, 0, count, clip);
+}
+
+static bool scalarSupported()
+{
+    return true;
+}
+
+#ifdef AUDIO_MIXER_X86
+
+//Four stereo frames per iteration
+__attribute__((target("sse2")))
+static void mixS16SSE2(float *dst, const Sint16 *src, bool monoSource, int frames, float left, float right)
+{
+    float leftScaled = left * S16Scale;
+    float rightScaled = right * S16Scale;
+    const __m128 gains = _mm_setr_ps(leftScaled, rightScaled, leftScaled, rightScaled);
+    int frame = 0;
+
+    if (monoSource) {
+        for (; frame + 8 <= frames; frame += 8) {
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + frame));
+            __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+            __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+            float *out = dst + frame * 2;
+            _mm_storeu_ps(out + 0, _mm_add_ps(_mm_loadu_ps(out + 0), _mm_mul_ps(_mm_unpacklo_ps(lo, lo), gains)));
+            _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_mul_ps(_mm_unpackhi_ps(lo, lo), gains)));
+            _mm_storeu_ps(out + 8, _mm_add_ps(_mm_loadu_ps(out + 8), _mm_mul_ps(_mm_unpacklo_ps(hi, hi), gains)));
+            _mm_storeu_ps(out + 12, _mm_add_ps(_mm_loadu_ps(out + 12), _mm_mul_ps(_mm_unpackhi_ps(hi, hi), gains)));
+        }
+    } else {
+        for (; frame + 4 <= frames; frame += 4) {
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + frame * 2));
+            __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+            __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+            float *out = dst + frame * 2;
+            _mm_storeu_ps(out + 0, _mm_add_ps(_mm_loadu_ps(out + 0), _mm_mul_ps(lo, gains)));
+            _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_mul_ps(hi, gains)));
+        }
+    }
+    mixFramesScalar(dst, 2, src, monoSource ? 1 : 2, frame, frames, left, right, S16Scale);
+}
+
+__attribute__((target("sse2")))
+static void mixF32SSE2(float *dst, const float *src, bool monoSource, int frames, float left, float right)
+{
+    const __m128 gains = _mm_setr_ps(left, right, left, right);
+    int frame = 0;
+
+    if (monoSource) {
+        for (; frame + 4 <= frames; frame += 4) {
+            __m128 in = _mm_loadu_ps(src + frame);
+            float *out = dst + frame * 2;
+            _mm_storeu_ps(out + 0, _mm_add_ps(_mm_loadu_ps(out + 0), _mm_mul_ps(_mm_unpacklo_ps(in, in), gains)));
+            _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_mul_ps(_mm_unpackhi_ps(in, in), gains)));
+        }
+    } else {
+        for (; frame + 2 <= frames; frame += 2) {
+            float *out = dst + frame * 2;
+            _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_mul_ps(_mm_loadu_ps(src + frame * 2), gains)));
+        }
+    }
+    mixFramesScalar(dst, 2, src, monoSource ? 1 : 2, frame, frames, left, right, 1.0f);
+}
+
+//Clamped first, the conversion turns anything out of range into INT_MIN
+__attribute__((target("sse2")))
+static inline __m128 clipSSE2(__m128 sample, MixClip clip)
+{
+    if (clip == MixClip::SOFT) {
+        __m128 x = _mm_min_ps(_mm_set1_ps(SoftClipLimit), _mm_max_ps(_mm_set1_ps(-SoftClipLimit), sample));
+        __m128 x2 = _mm_mul_ps(x, x);
+        __m128 numerator = _mm_mul_ps(x, _mm_add_ps(_mm_set1_ps(27.0f), x2));
+        __m128 denominator = _mm_add_ps(_mm_set1_ps(27.0f), _mm_mul_ps(_mm_set1_ps(9.0f), x2));
+        return _mm_mul_ps(_mm_div_ps(numerator, denominator), _mm_set1_ps(32767.0f));
+    }
+    return _mm_min_ps(_mm_set1_ps(32767.0f), _mm_max_ps(_mm_set1_ps(-32768.0f),
+                      _mm_mul_ps(sample, _mm_set1_ps(32768.0f))));
+}
+
+__attribute__((target("sse2")))
+static void mixdownSSE2(Sint16 *dst, const float *src, int count, MixClip clip)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_cvtps_epi32(clipSSE2(_mm_loadu_ps(src + i), clip));
+        __m128i hi = _mm_cvtps_epi32(clipSSE2(_mm_loadu_ps(src + i + 4), clip));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+    mixdownSamplesScalar(dst, src, i, count, clip);
+}
+
+//Eight stereo frames per iteration
+__attribute__((target("avx2")))
+static void mixS16AVX2(float *dst, const Sint16 *src, bool monoSource, int frames, float left, float right)
+{
+    float leftScaled = left * S16Scale;
+    float rightScaled = right * S16Scale;
+    const __m256 gains = _mm256_setr_ps(leftScaled, rightScaled, leftScaled, rightScaled,
+                                        leftScaled, rightScaled, leftScaled, rightScaled);
+    int frame = 0;
+
+    if (monoSource) {
+        const __m256i firstHalf = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+        const __m256i secondHalf = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+        for (; frame + 8 <= frames; frame += 8) {
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + frame));
+            __m256 samples = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(in));
+            float *out = dst + frame * 2;
+            _mm256_storeu_ps(out + 0, _mm256_add_ps(_mm256_loadu_ps(out + 0),
+                             _mm256_mul_ps(_mm256_permutevar8x32_ps(samples, firstHalf), gains)));
+            _mm256_storeu_ps(out + 8, _mm256_add_ps(_mm256_loadu_ps(out + 8),
+                             _mm256_mul_ps(_mm256_permutevar8x32_ps(samples, secondHalf), gains)));
+        }
+    } else {
+        for (; frame + 8 <= frames; frame += 8) {
+            const Sint16 *in = src + frame * 2;
+            __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))));
+            __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 8))));
+            float *out = dst + frame * 2;
+            _mm256_storeu_ps(out + 0, _mm256_add_ps(_mm256_loadu_ps(out + 0), _mm256_mul_ps(lo, gains)));
+            _mm256_storeu_ps(out + 8, _mm256_add_ps(_mm256_loadu_ps(out + 8), _mm256_mul_ps(hi, gains)));
+        }
+    }
+    mixFramesScalar(dst, 2, src, monoSource ? 1 : 2, frame, frames, left, right, S16Scale);
+}
+
+__attribute__((target("avx2")))
+static void mixF32AVX2(float *dst, const float *src, bool monoSource, int frames, float left, float right)
+{
+    const __m256 gains = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+    int frame = 0;
+
+    if (monoSource) {
+        const __m256i firstHalf = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+        const __m256i secondHalf = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+        for (; frame + 8 <= frames; frame += 8) {
+            __m256 in = _mm256_loadu_ps(src + frame);
+            float *out = dst + frame * 2;
+            _mm256_storeu_ps(out + 0, _mm256_add_ps(_mm256_loadu_ps(out + 0),
+                             _mm256_mul_ps(_mm256_permutevar8x32_ps(in, firstHalf), gains)));
+            _mm256_storeu_ps(out + 8, _mm256_add_ps(_mm256_loadu_ps(out + 8),
+                             _mm256_mul_ps(_mm256_permutevar8x32_ps(in, secondHalf), gains)));
+        }
+    } else {
+        for (; frame + 4 <= frames; frame += 4) {
+            float *out = dst + frame * 2;
+            _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(out),
+                             _mm256_mul_ps(_mm256_loadu_ps(src + frame * 2), gains)));
+        }
+    }
+    mixFramesScalar(dst, 2, src, monoSource ? 1 : 2, frame, frames, left, right, 1.0f);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 clipAVX2(__m256 sample, MixClip clip)
+{
+    if (clip == MixClip::SOFT) {
+        __m256 x = _mm256_min_ps(_mm256_set1_ps(SoftClipLimit), _mm256_max_ps(_mm256_set1_ps(-SoftClipLimit), sample));
+        __m256 x2 = _mm256_mul_ps(x, x);
+        __m256 numerator = _mm256_mul_ps(x, _mm256_add_ps(_mm256_set1_ps(27.0f), x2));
+        __m256 denominator = _mm256_add_ps(_mm256_set1_ps(27.0f), _mm256_mul_ps(_mm256_set1_ps(9.0f), x2));
+        return _mm256_mul_ps(_mm256_div_ps(numerator, denominator), _mm256_set1_ps(32767.0f));
+    }
+    return _mm256_min_ps(_mm256_set1_ps(32767.0f), _mm256_max_ps(_mm256_set1_ps(-32768.0f),
+                         _mm256_mul_ps(sample, _mm256_set1_ps(32768.0f))));
+}
+
+__attribute__((target("avx2")))
+static void mixdownAVX2(Sint16 *dst, const float *src, int count, MixClip clip)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_cvtps_epi32(clipAVX2(_mm256_loadu_ps(src + i), clip));
+        __m256i hi = _mm256_cvtps_epi32(clipAVX2(_mm256_loadu_ps(src + i + 8), clip));
+        //packs works per 128-bit lane, the permute puts the samples back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    mixdownSamplesScalar(dst, src, i, count, clip);
+}
+
+static bool sse2Supported()
+{
+    return SDL_HasSSE2();
+}
+
+static bool avx2Supported()
+{
+    return SDL_HasAVX2();
+}
+
+#endif
+
+#ifdef AUDIO_MIXER_NEON
+
+//Four stereo frames per iteration
+static void mixS16NEON(float *dst, const Sint16 *src, bool monoSource, int frames, float left, float right)
+{
+    float leftScaled = left * S16Scale;
+    float rightScaled = right * S16Scale;
+    const float gainPair[4] = { leftScaled, rightScaled, leftScaled, rightScaled };
+    const float32x4_t gains = vld1q_f32(gainPair);
+    int frame = 0;
+
+    if (monoSource) {
+        for (; frame + 4 <= frames; frame += 4) {
+            float32x4_t in = vcvtq_f32_s32(vmovl_s16(vld1_s16(src + frame)));
+            float32x4x2_t pairs = vzipq_f32(in, in);
+            float *out = dst + frame * 2;
+            vst1q_f32(out + 0, vaddq_f32(vld1q_f32(out + 0), vmulq_f32(pairs.val[0], gains)));
+            vst1q_f32(out + 4, vaddq_f32(vld1q_f32(out + 4), vmulq_f32(pairs.val[1], gains)));
+        }
+    } else {
+        for (; frame + 4 <= frames; frame += 4) {
+            int16x8_t in = vld1q_s16(src + frame * 2);
+            float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(in)));
+            float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(in)));
+            float *out = dst + frame * 2;
+            vst1q_f32(out + 0, vaddq_f32(vld1q_f32(out + 0), vmulq_f32(lo, gains)));
+            vst1q_f32(out + 4, vaddq_f32(vld1q_f32(out + 4), vmulq_f32(hi, gains)));
+        }
+    }
+    mixFramesScalar(dst, 2, src, monoSource ? 1 : 2, frame, frames, left, right, S16Scale);
+}
+
+static void mixF32NEON(float *dst, const float *src, bool monoSource, int frames, float left, float right)
+{
+    const float gainPair[4] = { left, right, left, right };
+    const float32x4_t gains = vld1q_f32(gainPair);
+    int frame = 0;
+
+    if (monoSource) {
+        for (; frame + 4 <= frames; frame += 4) {
+            float32x4_t in = vld1q_f32(src + frame);
+            float32x4x2_t pairs = vzipq_f32(in, in);
+            float *out = dst + frame * 2;
+            vst1q_f32(out + 0, vaddq_f32(vld1q_f32(out + 0), vmulq_f32(pairs.val[0], gains)));
+            vst1q_f32(out + 4, vaddq_f32(vld1q_f32(out + 4), vmulq_f32(pairs.val[1], gains)));
+        }
+    } else {
+        for (; frame + 2 <= frames; frame += 2) {
+            float *out = dst + frame * 2;
+            vst1q_f32(out, vaddq_f32(vld1q_f32(out), vmulq_f32(vld1q_f32(src + frame * 2), gains)));
+        }
+    }
+    mixFramesScalar(dst, 2, src, monoSource ? 1 : 2, frame, frames, left, right, 1.0f);
+}
+
+static inline float32x4_t clipNEON(float32x4_t sample, MixClip clip)
+{
+    if (clip == MixClip::SOFT) {
+        float32x4_t x = vminq_f32(vdupq_n_f32(SoftClipLimit), vmaxq_f32(vdupq_n_f32(-SoftClipLimit), sample));
+        float32x4_t x2 = vmulq_f32(x, x);
+        float32x4_t numerator = vmulq_f32(x, vaddq_f32(vdupq_n_f32(27.0f), x2));
+        float32x4_t denominator = vaddq_f32(vdupq_n_f32(27.0f), vmulq_f32(vdupq_n_f32(9.0f), x2));
+        return vmulq_f32(vdivq_f32(numerator, denominator), vdupq_n_f32(32767.0f));
+    }
+    return vminq_f32(vdupq_n_f32(32767.0f), vmaxq_f32(vdupq_n_f32(-32768.0f),
+                     vmulq_f32(sample, vdupq_n_f32(32768.0f))));
+}
+
+static void mixdownNEON(Sint16 *dst, const float *src, int count, MixClip clip)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int32x4_t lo = vcvtnq_s32_f32(clipNEON(vld1q_f32(src + i), clip));
+        int32x4_t hi = vcvtnq_s32_f32(clipNEON(vld1q_f32(src + i + 4), clip));
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+    mixdownSamplesScalar(dst, src, i, count, clip);
+}
+
+static bool neonSupported()
+{
+    return SDL_HasNEON();
+}
+
+#endif
+
+struct MixKernel
+{
+    const char *name;
+    MixS16Func mixS16;
+    MixF32Func mixF32;
+    MixdownFunc mixdown;
+    bool (*supported)();
+};
+
+//Best first
+static const MixKernel MixKernels[] = {
+#ifdef AUDIO_MIXER_X86
+    { "avx2", mixS16AVX2, mixF32AVX2, mixdownAVX2, avx2Supported },
+    { "sse2", mixS16SSE2, mixF32SSE2, mixdownSSE2, sse2Supported },
+#endif
+#ifdef AUDIO_MIXER_NEON
+    { "neon", mixS16NEON, mixF32NEON, mixdownNEON, neonSupported },
+#endif
+    { "scalar", mixS16Scalar, mixF32Scalar, mixdownScalar, scalarSupported },
+};
+
+static std::atomic<const MixKernel*> activeKernel{nullptr};
+
+static const MixKernel* findKernel(const std::string &name)
+{
+    for (const MixKernel &kernel : MixKernels) {
+        if (name == kernel.name) return kernel.supported() ? &kernel : nullptr;
+    }
+    return nullptr;
+}
+
+static const MixKernel* getKernel()
+{
+    const MixKernel *kernel = activeKernel.load(std::memory_order_acquire);
+    if (kernel) return kernel;
+
+    const char *forced = SDL_getenv("ATARAXIA_MIX_KERNEL");
+    if (forced && *forced) {
+        kernel = findKernel(forced);
+        if (!kernel) SDL_Log("Audio mix kernel '%s' isn't available here", forced);
+    }
+    for (const MixKernel &candidate : MixKernels) {
+        if (kernel) break;
+        if (candidate.supported()) kernel = &candidate;
+    }
+    SDL_Log("Audio mix kernel: %s", kernel->name);
+    activeKernel.store(kernel, std::memory_order_release);
+    return kernel;
+}
+
+const char* getAudioMixKernelName()
+{
+    return getKernel()->name;
+}
+
+bool setAudioMixKernel(const std::string &name)
+{
+    const MixKernel *kernel = findKernel(name);
+    if (!kernel) return false;
+    activeKernel.store(kernel, std::memory_order_release);
+    return true;
+}
+
+void mixVoiceS16(float *dst, int dstChannels, const Sint16 *src, int srcChannels, int frames, MixGains gains)
+{
+    if (srcChannels != 1 && srcChannels != dstChannels) return;
+    if (dstChannels == 2) {
+        getKernel()->mixS16(dst, src, srcChannels == 1, frames, gains.left, gains.right);
+    } else {
+        mixFramesScalar(dst, dstChannels, src, srcChannels, 0, frames, gains.left, gains.right, S16Scale);
+    }
+}
+
+void mixVoiceF32(float *dst, int dstChannels, const float *src, int srcChannels, int frames, MixGains gains)
+{
+    if (srcChannels != 1 && srcChannels != dstChannels) return;
+    if (dstChannels == 2) {
+        getKernel()->mixF32(dst, src, srcChannels == 1, frames, gains.left, gains.right);
+    } else {
+        mixFramesScalar(dst, dstChannels, src, srcChannels, 0, frames, gains.left, gains.right, 1.0f);
+    }
+}
+
+void mixdownToS16(Sint16 *dst, const float *src, int count, MixClip clip)
+{
+    getKernel()->mixdown(dst, src, count, clip);
+}
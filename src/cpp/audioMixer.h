@@ -0,0 +1,44 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <string>
+#include <SDL3/SDL.h>
+
+//Mixing kernels for the audio engine with scalar, SSE2, AVX2 and NEON
+//versions. Voices are summed into an interleaved float accumulator, which is
+//then clipped into S16 output. Every kernel gives the same result as the
+//scalar one, bit for bit.
+
+//Per-voice gains for the first two output channels. Other channels get the
+//average of the two.
+struct MixGains
+{
+    float left = 1.0f;
+    float right = 1.0f;
+};
+
+//Balance law: pan 0 plays both sides at gain, -1 silences the right side and
+//+1 the left
+MixGains panGains(float gain, float pan);
+
+//Adds frames of src into dst. src has either one channel, which is spread to
+//every output channel, or the same channel count as dst.
+void mixVoiceS16(float *dst, int dstChannels, const Sint16 *src, int srcChannels, int frames, MixGains gains);
+void mixVoiceF32(float *dst, int dstChannels, const float *src, int srcChannels, int frames, MixGains gains);
+
+enum class MixClip
+{
+    SATURATE,       //hard limit at full scale
+    SOFT            //rounds off peaks smoothly from about -6 dBFS up
+};
+
+//Converts count samples of the accumulator, full scale +-1.0, to S16
+void mixdownToS16(Sint16 *dst, const float *src, int count, MixClip clip);
+
+//The kernel is picked on first use from the CPU's features, or forced with
+//ATARAXIA_MIX_KERNEL=scalar|sse2|avx2|neon
+const char* getAudioMixKernelName();
+//Returns false if the kernel isn't built for or supported by this CPU
+bool setAudioMixKernel(const std::string &name);
+
+#endif
@@ -0,0 +1,119 @@
+#include "audioRingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool createAudioRing(AudioRingBuffer &ring, size_t minBytes)
+{
+    size_t capacity = 1;
+    while (capacity < minBytes) capacity <<= 1;
+
+    ring.data = static_cast<Uint8*>(SDL_malloc(capacity));
+    if (!ring.data) {
+        SDL_Log("Failed to allocate %zu byte audio ring", capacity);
+        return false;
+    }
+    ring.capacity = capacity;
+    ring.mask = capacity - 1;
+    resetAudioRing(ring);
+    return true;
+}
+
+void destroyAudioRing(AudioRingBuffer &ring)
+{
+    SDL_free(ring.data);
+    ring.data = nullptr;
+    ring.capacity = 0;
+    ring.mask = 0;
+}
+
+void resetAudioRing(AudioRingBuffer &ring)
+{
+    ring.writePos.store(0, std::memory_order_relaxed);
+    ring.readPos.store(0, std::memory_order_relaxed);
+    ring.underruns.store(0, std::memory_order_relaxed);
+    ring.overruns.store(0, std::memory_order_relaxed);
+}
+
+size_t getAudioRingFree(const AudioRingBuffer &ring)
+{
+    size_t write = ring.writePos.load(std::memory_order_relaxed);
+    size_t read = ring.readPos.load(std::memory_order_acquire);
+    return ring.capacity - (write - read);
+}
+
+size_t getAudioRingQueued(const AudioRingBuffer &ring)
+{
+    size_t write = ring.writePos.load(std::memory_order_acquire);
+    size_t read = ring.readPos.load(std::memory_order_relaxed);
+    return write - read;
+}
+
+size_t writeAudioRing(AudioRingBuffer &ring, const void *src, size_t bytes)
+{
+    size_t write = ring.writePos.load(std::memory_order_relaxed);
+    size_t read = ring.readPos.load(std::memory_order_acquire);
+    size_t count = std::min(bytes, ring.capacity - (write - read));
+    if (count < bytes) {
+        ring.overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (count == 0) return 0;
+
+    //At most two copies, up to the end of the buffer and then from the start
+    size_t offset = write & ring.mask;
+    size_t first = std::min(count, ring.capacity - offset);
+    std::memcpy(ring.data + offset, src, first);
+    std::memcpy(ring.data, static_cast<const Uint8*>(src) + first, count - first);
+    ring.writePos.store(write + count, std::memory_order_release);
+    return count;
+}
+
+bool writeAudioRingRecord(AudioRingBuffer &ring, const void *src, size_t bytes)
+{
+    if (getAudioRingFree(ring) < bytes) {
+        ring.overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return writeAudioRing(ring, src, bytes) == bytes;
+}
+
+size_t readAudioRing(AudioRingBuffer &ring, void *dst, size_t bytes)
+{
+    size_t read = ring.readPos.load(std::memory_order_relaxed);
+    size_t write = ring.writePos.load(std::memory_order_acquire);
+    size_t count = std::min(bytes, write - read);
+    if (count < bytes) {
+        ring.underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (count == 0) return 0;
+
+    size_t offset = read & ring.mask;
+    size_t first = std::min(count, ring.capacity - offset);
+    std::memcpy(dst, ring.data + offset, first);
+    std::memcpy(static_cast<Uint8*>(dst) + first, ring.data, count - first);
+    ring.readPos.store(read + count, std::memory_order_release);
+    return count;
+}
+
+size_t peekAudioRing(const AudioRingBuffer &ring, void *dst, size_t bytes)
+{
+    size_t read = ring.readPos.load(std::memory_order_relaxed);
+    size_t write = ring.writePos.load(std::memory_order_acquire);
+    size_t count = std::min(bytes, write - read);
+    if (count == 0) return 0;
+
+    size_t offset = read & ring.mask;
+    size_t first = std::min(count, ring.capacity - offset);
+    std::memcpy(dst, ring.data + offset, first);
+    std::memcpy(static_cast<Uint8*>(dst) + first, ring.data, count - first);
+    return count;
+}
+
+size_t discardAudioRing(AudioRingBuffer &ring, size_t bytes)
+{
+    size_t read = ring.readPos.load(std::memory_order_relaxed);
+    size_t write = ring.writePos.load(std::memory_order_acquire);
+    size_t count = std::min(bytes, write - read);
+    ring.readPos.store(read + count, std::memory_order_release);
+    return count;
+}
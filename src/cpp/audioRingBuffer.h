@@ -0,0 +1,52 @@
+#ifndef AUDIO_RING_BUFFER_H
+#define AUDIO_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <SDL3/SDL.h>
+
+//Single producer / single consumer byte ring with no locks, meant to sit
+//between a thread that makes audio and SDL's audio callback. Capacity is a
+//power of two so positions wrap with a mask; readPos and writePos only ever
+//grow and each is written by one side only.
+struct AudioRingBuffer
+{
+    Uint8 *data = nullptr;
+    size_t capacity = 0;
+    size_t mask = 0;
+    //Kept on separate cache lines so the two threads don't share one
+    alignas(64) std::atomic<size_t> writePos{0};
+    alignas(64) std::atomic<size_t> readPos{0};
+    //Reads that came up short (the device got silence) and writes that
+    //didn't fit (data was dropped)
+    alignas(64) std::atomic<Uint64> underruns{0};
+    std::atomic<Uint64> overruns{0};
+};
+
+//Rounds minBytes up to a power of two. Not thread safe, call before either
+//side starts.
+bool createAudioRing(AudioRingBuffer &ring, size_t minBytes);
+void destroyAudioRing(AudioRingBuffer &ring);
+//Only valid while neither side is running
+void resetAudioRing(AudioRingBuffer &ring);
+
+//Producer side. Writes what fits and counts an overrun when that is less
+//than bytes.
+size_t writeAudioRing(AudioRingBuffer &ring, const void *src, size_t bytes);
+size_t getAudioRingFree(const AudioRingBuffer &ring);
+//For fixed-size records (commands, markers): writes all of bytes or, when
+//they don't fit, nothing and counts an overrun. A partial record would
+//misalign every read after it.
+bool writeAudioRingRecord(AudioRingBuffer &ring, const void *src, size_t bytes);
+
+//Consumer side. Reads what is there and counts an underrun when that is
+//less than bytes.
+size_t readAudioRing(AudioRingBuffer &ring, void *dst, size_t bytes);
+//Copies up to bytes of queued data without consuming it or counting an
+//underrun
+size_t peekAudioRing(const AudioRingBuffer &ring, void *dst, size_t bytes);
+//Drops up to bytes of queued data without copying it
+size_t discardAudioRing(AudioRingBuffer &ring, size_t bytes);
+size_t getAudioRingQueued(const AudioRingBuffer &ring);
+
+#endif
@@ -0,0 +1,417 @@
+#include "colorConvert.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COLOR_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define COLOR_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+//Fixed point shared by every kernel: samples are centred and shifted left 7,
+//multiplied by coefficients scaled by 2048 keeping the high 16 bits, which
+//leaves results with 2 fractional bits. That is exactly _mm_mulhi_epi16, and
+//vqdmulhq_s16 on samples shifted by 6.
+struct ConvertCoefficients
+{
+    Sint16 yOffset;
+    Sint16 yScale;
+    Sint16 rv;
+    Sint16 gu;
+    Sint16 gv;
+    Sint16 bu;
+};
+
+static const ConvertCoefficients MatrixCoefficients[] = {
+    { 16, 2385, 3269, 802, 1665, 4131 },    //BT.601 limited
+    { 0, 2048, 2871, 705, 1463, 3629 },     //BT.601 full
+    { 16, 2385, 3672, 437, 1091, 4326 },    //BT.709 limited
+    { 0, 2048, 3225, 384, 959, 3800 },      //BT.709 full
+};
+
+typedef void (*ConvertRowFunc)(const Uint8 *y, const Uint8 *u, const Uint8 *v, Uint8 *dst,
+                               int width, const ConvertCoefficients &c, bool bgra);
+
+static inline int mulHigh(int sample, int coefficient)
+{
+    return (sample * coefficient) >> 16;
+}
+
+static inline Uint8 clampToByte(int value)
+{
+    return static_cast<Uint8>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+//Converts pixels [x, width) of one row. The SIMD kernels finish their rows
+//with it, so it must stay bit-exact with them.
+template <bool Interleaved>
+static void convertPixelsScalar(const Uint8 *y, const Uint8 *u, const Uint8 *v, Uint8 *dst,
+                                int x, int width, const ConvertCoefficients &c, bool bgra)
+{
+    for (; x < width; ++x) {
+        int pair = x / 2;
+        int uSample = Interleaved ? u[pair * 2] : u[pair];
+        int vSample = Interleaved ? u[pair * 2 + 1] : v[pair];
+        int uc = (uSample - 128) * 128;
+        int vc = (vSample - 128) * 128;
+        int luma = mulHigh((y[x] - c.yOffset) * 128, c.yScale);
+
+        int r = (luma + mulHigh(vc, c.rv) + 2) >> 2;
+        int g = (luma - (mulHigh(uc, c.gu) + mulHigh(vc, c.gv)) + 2) >> 2;
+        int b = (luma + mulHigh(uc, c.bu) + 2) >> 2;
+
+        Uint8 *pixel = dst + x * 4;
+        pixel[0] = clampToByte(bgra ? b : r);
+        pixel[1] = clampToByte(g);
+        pixel[2] = clampToByte(bgra ? r : b);
+        pixel[3] = 255;
+    }
+}
+
+template <bool Interleaved>
+static void convertRowScalar(const Uint8 *y, const Uint8 *u, const Uint8 *v, Uint8 *dst,
+                             int width, const ConvertCoefficients &c, bool bgra)
+{
+    convertPixelsScalar<Interleaved>(y, u, v, dst, 0, width, c, bgra);
+}
+
+static bool scalarSupported()
+{
+    return true;
+}
+
+#ifdef COLOR_CONVERT_X86
+
+//16 pixels per iteration
+template <bool Interleaved>
+__attribute__((target("sse2")))
+static void convertRowSSE2(const Uint8 *y, const Uint8 *u, const Uint8 *v, Uint8 *dst,
+                           int width, const ConvertCoefficients &c, bool bgra)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+    const __m128i chromaOffset = _mm_set1_epi16(128);
+    const __m128i yOffset = _mm_set1_epi16(c.yOffset);
+    const __m128i yScale = _mm_set1_epi16(c.yScale);
+    const __m128i rv = _mm_set1_epi16(c.rv);
+    const __m128i gu = _mm_set1_epi16(c.gu);
+    const __m128i gv = _mm_set1_epi16(c.gv);
+    const __m128i bu = _mm_set1_epi16(c.bu);
+    const __m128i round = _mm_set1_epi16(2);
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xFF));
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i uLanes, vLanes;
+        if (Interleaved) {
+            __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x));
+            uLanes = _mm_and_si128(uv, lowBytes);
+            vLanes = _mm_srli_epi16(uv, 8);
+        } else {
+            uLanes = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2)), zero);
+            vLanes = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2)), zero);
+        }
+        __m128i uc = _mm_slli_epi16(_mm_sub_epi16(uLanes, chromaOffset), 7);
+        __m128i vc = _mm_slli_epi16(_mm_sub_epi16(vLanes, chromaOffset), 7);
+
+        //Chroma terms once per pair, then widened to both pixels of the pair
+        __m128i rTerm = _mm_mulhi_epi16(vc, rv);
+        __m128i gTerm = _mm_add_epi16(_mm_mulhi_epi16(uc, gu), _mm_mulhi_epi16(vc, gv));
+        __m128i bTerm = _mm_mulhi_epi16(uc, bu);
+
+        __m128i yBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+        __m128i lumaLo = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(yBytes, zero), yOffset), 7), yScale);
+        __m128i lumaHi = _mm_mulhi_epi16(_mm_slli_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(yBytes, zero), yOffset), 7), yScale);
+
+        __m128i rLo = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(lumaLo, _mm_unpacklo_epi16(rTerm, rTerm)), round), 2);
+        __m128i rHi = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(lumaHi, _mm_unpackhi_epi16(rTerm, rTerm)), round), 2);
+        __m128i gLo = _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(lumaLo, _mm_unpacklo_epi16(gTerm, gTerm)), round), 2);
+        __m128i gHi = _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(lumaHi, _mm_unpackhi_epi16(gTerm, gTerm)), round), 2);
+        __m128i bLo = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(lumaLo, _mm_unpacklo_epi16(bTerm, bTerm)), round), 2);
+        __m128i bHi = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(lumaHi, _mm_unpackhi_epi16(bTerm, bTerm)), round), 2);
+
+        __m128i r = _mm_packus_epi16(rLo, rHi);
+        __m128i g = _mm_packus_epi16(gLo, gHi);
+        __m128i b = _mm_packus_epi16(bLo, bHi);
+        __m128i first = bgra ? b : r;
+        __m128i third = bgra ? r : b;
+
+        __m128i firstSecondLo = _mm_unpacklo_epi8(first, g);
+        __m128i firstSecondHi = _mm_unpackhi_epi8(first, g);
+        __m128i thirdAlphaLo = _mm_unpacklo_epi8(third, alpha);
+        __m128i thirdAlphaHi = _mm_unpackhi_epi8(third, alpha);
+        __m128i *out = reinterpret_cast<__m128i*>(dst + x * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(firstSecondLo, thirdAlphaLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(firstSecondLo, thirdAlphaLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(firstSecondHi, thirdAlphaHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(firstSecondHi, thirdAlphaHi));
+    }
+    convertPixelsScalar<Interleaved>(y, u, v, dst, x, width, c, bgra);
+}
+
+//32 pixels per iteration. The unpack instructions work within 128-bit lanes,
+//so chroma is permuted before widening and the output lanes are recombined.
+template <bool Interleaved>
+__attribute__((target("avx2")))
+static void convertRowAVX2(const Uint8 *y, const Uint8 *u, const Uint8 *v, Uint8 *dst,
+                           int width, const ConvertCoefficients &c, bool bgra)
+{
+    const __m256i lowBytes = _mm256_set1_epi16(0x00FF);
+    const __m256i chromaOffset = _mm256_set1_epi16(128);
+    const __m256i yOffset = _mm256_set1_epi16(c.yOffset);
+    const __m256i yScale = _mm256_set1_epi16(c.yScale);
+    const __m256i rv = _mm256_set1_epi16(c.rv);
+    const __m256i gu = _mm256_set1_epi16(c.gu);
+    const __m256i gv = _mm256_set1_epi16(c.gv);
+    const __m256i bu = _mm256_set1_epi16(c.bu);
+    const __m256i round = _mm256_set1_epi16(2);
+    const __m256i alpha = _mm256_set1_epi8(static_cast<char>(0xFF));
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i uLanes, vLanes;
+        if (Interleaved) {
+            __m256i uv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(u + x));
+            uLanes = _mm256_and_si256(uv, lowBytes);
+            vLanes = _mm256_srli_epi16(uv, 8);
+        } else {
+            uLanes = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x / 2)));
+            vLanes = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + x / 2)));
+        }
+        __m256i uc = _mm256_slli_epi16(_mm256_sub_epi16(uLanes, chromaOffset), 7);
+        __m256i vc = _mm256_slli_epi16(_mm256_sub_epi16(vLanes, chromaOffset), 7);
+
+        //Pairs 0-3, 8-11 | 4-7, 12-15 so the in-lane unpacks below come out
+        //as pairs 0-7 (pixels 0-15) and pairs 8-15 (pixels 16-31)
+        __m256i rTerm = _mm256_permute4x64_epi64(_mm256_mulhi_epi16(vc, rv), 0xD8);
+        __m256i gTerm = _mm256_permute4x64_epi64(
+            _mm256_add_epi16(_mm256_mulhi_epi16(uc, gu), _mm256_mulhi_epi16(vc, gv)), 0xD8);
+        __m256i bTerm = _mm256_permute4x64_epi64(_mm256_mulhi_epi16(uc, bu), 0xD8);
+
+        __m256i yBytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + x));
+        __m256i lumaLo = _mm256_mulhi_epi16(_mm256_slli_epi16(_mm256_sub_epi16(
+            _mm256_cvtepu8_epi16(_mm256_castsi256_si128(yBytes)), yOffset), 7), yScale);
+        __m256i lumaHi = _mm256_mulhi_epi16(_mm256_slli_epi16(_mm256_sub_epi16(
+            _mm256_cvtepu8_epi16(_mm256_extracti128_si256(yBytes, 1)), yOffset), 7), yScale);
+
+        __m256i rLo = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(lumaLo, _mm256_unpacklo_epi16(rTerm, rTerm)), round), 2);
+        __m256i rHi = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(lumaHi, _mm256_unpackhi_epi16(rTerm, rTerm)), round), 2);
+        __m256i gLo = _mm256_srai_epi16(_mm256_add_epi16(_mm256_sub_epi16(lumaLo, _mm256_unpacklo_epi16(gTerm, gTerm)), round), 2);
+        __m256i gHi = _mm256_srai_epi16(_mm256_add_epi16(_mm256_sub_epi16(lumaHi, _mm256_unpackhi_epi16(gTerm, gTerm)), round), 2);
+        __m256i bLo = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(lumaLo, _mm256_unpacklo_epi16(bTerm, bTerm)), round), 2);
+        __m256i bHi = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(lumaHi, _mm256_unpackhi_epi16(bTerm, bTerm)), round), 2);
+
+        //Packing leaves pixels 0-7, 16-23 | 8-15, 24-31
+        __m256i r = _mm256_packus_epi16(rLo, rHi);
+        __m256i g = _mm256_packus_epi16(gLo, gHi);
+        __m256i b = _mm256_packus_epi16(bLo, bHi);
+        __m256i first = bgra ? b : r;
+        __m256i third = bgra ? r : b;
+
+        //Pixels 0-7 | 8-15 and 16-23 | 24-31
+        __m256i firstSecondLo = _mm256_unpacklo_epi8(first, g);
+        __m256i firstSecondHi = _mm256_unpackhi_epi8(first, g);
+        __m256i thirdAlphaLo = _mm256_unpacklo_epi8(third, alpha);
+        __m256i thirdAlphaHi = _mm256_unpackhi_epi8(third, alpha);
+
+        __m256i quadA = _mm256_unpacklo_epi16(firstSecondLo, thirdAlphaLo);    //0-3 | 8-11
+        __m256i quadB = _mm256_unpackhi_epi16(firstSecondLo, thirdAlphaLo);    //4-7 | 12-15
+        __m256i quadC = _mm256_unpacklo_epi16(firstSecondHi, thirdAlphaHi);    //16-19 | 24-27
+        __m256i quadD = _mm256_unpackhi_epi16(firstSecondHi, thirdAlphaHi);    //20-23 | 28-31
+
+        __m256i *out = reinterpret_cast<__m256i*>(dst + x * 4);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(quadA, quadB, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(quadA, quadB, 0x31));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(quadC, quadD, 0x20));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(quadC, quadD, 0x31));
+    }
+    convertPixelsScalar<Interleaved>(y, u, v, dst, x, width, c, bgra);
+}
+
+static bool sse2Supported()
+{
+    return SDL_HasSSE2();
+}
+
+static bool avx2Supported()
+{
+    return SDL_HasAVX2();
+}
+
+#endif
+
+#ifdef COLOR_CONVERT_NEON
+
+//16 pixels per iteration. vqdmulh doubles the product, so samples are
+//shifted by 6 rather than 7 to land on the same fixed point.
+template <bool Interleaved>
+static void convertRowNEON(const Uint8 *y, const Uint8 *u, const Uint8 *v, Uint8 *dst,
+                           int width, const ConvertCoefficients &c, bool bgra)
+{
+    const int16x8_t chromaOffset = vdupq_n_s16(128);
+    const int16x8_t yOffset = vdupq_n_s16(c.yOffset);
+    const uint8x16_t alpha = vdupq_n_u8(255);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        int16x8_t uLanes, vLanes;
+        if (Interleaved) {
+            uint8x8x2_t uv = vld2_u8(u + x);
+            uLanes = vreinterpretq_s16_u16(vmovl_u8(uv.val[0]));
+            vLanes = vreinterpretq_s16_u16(vmovl_u8(uv.val[1]));
+        } else {
+            uLanes = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x / 2)));
+            vLanes = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + x / 2)));
+        }
+        int16x8_t uc = vshlq_n_s16(vsubq_s16(uLanes, chromaOffset), 6);
+        int16x8_t vc = vshlq_n_s16(vsubq_s16(vLanes, chromaOffset), 6);
+
+        int16x8x2_t rTerm = vzipq_s16(vqdmulhq_n_s16(vc, c.rv), vqdmulhq_n_s16(vc, c.rv));
+        int16x8_t gPair = vaddq_s16(vqdmulhq_n_s16(uc, c.gu), vqdmulhq_n_s16(vc, c.gv));
+        int16x8x2_t gTerm = vzipq_s16(gPair, gPair);
+        int16x8x2_t bTerm = vzipq_s16(vqdmulhq_n_s16(uc, c.bu), vqdmulhq_n_s16(uc, c.bu));
+
+        uint8x16_t yBytes = vld1q_u8(y + x);
+        int16x8_t lumaLo = vqdmulhq_n_s16(vshlq_n_s16(vsubq_s16(
+            vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(yBytes))), yOffset), 6), c.yScale);
+        int16x8_t lumaHi = vqdmulhq_n_s16(vshlq_n_s16(vsubq_s16(
+            vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(yBytes))), yOffset), 6), c.yScale);
+
+        //Rounding shift is the (x + 2) >> 2 of the other kernels
+        uint8x16_t r = vcombine_u8(vqmovun_s16(vrshrq_n_s16(vaddq_s16(lumaLo, rTerm.val[0]), 2)),
+                                   vqmovun_s16(vrshrq_n_s16(vaddq_s16(lumaHi, rTerm.val[1]), 2)));
+        uint8x16_t g = vcombine_u8(vqmovun_s16(vrshrq_n_s16(vsubq_s16(lumaLo, gTerm.val[0]), 2)),
+                                   vqmovun_s16(vrshrq_n_s16(vsubq_s16(lumaHi, gTerm.val[1]), 2)));
+        uint8x16_t b = vcombine_u8(vqmovun_s16(vrshrq_n_s16(vaddq_s16(lumaLo, bTerm.val[0]), 2)),
+                                   vqmovun_s16(vrshrq_n_s16(vaddq_s16(lumaHi, bTerm.val[1]), 2)));
+
+        uint8x16x4_t pixels;
+        pixels.val[0] = bgra ? b : r;
+        pixels.val[1] = g;
+        pixels.val[2] = bgra ? r : b;
+        pixels.val[3] = alpha;
+        vst4q_u8(dst + x * 4, pixels);
+    }
+    convertPixelsScalar<Interleaved>(y, u, v, dst, x, width, c, bgra);
+}
+
+static bool neonSupported()
+{
+    return SDL_HasNEON();
+}
+
+#endif
+
+struct ConvertKernel
+{
+    const char *name;
+    ConvertRowFunc planar;
+    ConvertRowFunc interleaved;
+    bool (*supported)();
+};
+
+//Best first
+static const ConvertKernel ConvertKernels[] = {
+#ifdef COLOR_CONVERT_X86
+    { "avx2", convertRowAVX2<false>, convertRowAVX2<true>, avx2Supported },
+    { "sse2", convertRowSSE2<false>, convertRowSSE2<true>, sse2Supported },
+#endif
+#ifdef COLOR_CONVERT_NEON
+    { "neon", convertRowNEON<false>, convertRowNEON<true>, neonSupported },
+#endif
+    { "scalar", convertRowScalar<false>, convertRowScalar<true>, scalarSupported },
+};
+
+static std::atomic<const ConvertKernel*> activeKernel{nullptr};
+
+static const ConvertKernel* findKernel(const std::string &name)
+{
+    for (const ConvertKernel &kernel : ConvertKernels) {
+        if (name == kernel.name) return kernel.supported() ? &kernel : nullptr;
+    }
+    return nullptr;
+}
+
+static const ConvertKernel* getKernel()
+{
+    const ConvertKernel *kernel = activeKernel.load(std::memory_order_acquire);
+    if (kernel) return kernel;
+
+    const char *forced = SDL_getenv("ATARAXIA_COLOR_KERNEL");
+    if (forced && *forced) {
+        kernel = findKernel(forced);
+        if (!kernel) SDL_Log("Color conversion kernel '%s' isn't available here", forced);
+    }
+    for (const ConvertKernel &candidate : ConvertKernels) {
+        if (kernel) break;
+        if (candidate.supported()) kernel = &candidate;
+    }
+    SDL_Log("Color conversion kernel: %s", kernel->name);
+    activeKernel.store(kernel, std::memory_order_release);
+    return kernel;
+}
+
+const char* getColorConvertKernelName()
+{
+    return getKernel()->name;
+}
+
+bool setColorConvertKernel(const std::string &name)
+{
+    const ConvertKernel *kernel = findKernel(name);
+    if (!kernel) return false;
+    activeKernel.store(kernel, std::memory_order_release);
+    return true;
+}
+
+void convertYUVToRGBA(const YUVImage &image, YUVMatrix matrix, RGBAOrder order, Uint8 *dst, int dstStride)
+{
+    const ConvertKernel *kernel = getKernel();
+    ConvertRowFunc convertRow = image.interleavedChroma ? kernel->interleaved : kernel->planar;
+    const ConvertCoefficients &coefficients = MatrixCoefficients[static_cast<int>(matrix)];
+    bool bgra = order == RGBAOrder::BGRA;
+
+    for (int row = 0; row < image.height; ++row) {
+        int chromaRow = row / 2;
+        convertRow(image.planes[0] + row * image.strides[0],
+                   image.planes[1] + chromaRow * image.strides[1],
+                   image.interleavedChroma ? nullptr : image.planes[2] + chromaRow * image.strides[2],
+                   dst + row * dstStride, image.width, coefficients, bgra);
+    }
+}
+
+YUVMatrix frameYUVMatrix(const AVFrame *frame)
+{
+    bool fullRange = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P;
+    if (frame->colorspace == AVCOL_SPC_BT709) {
+        return fullRange ? YUVMatrix::BT709_FULL : YUVMatrix::BT709_LIMITED;
+    }
+    return fullRange ? YUVMatrix::BT601_FULL : YUVMatrix::BT601_LIMITED;
+}
+
+bool convertFrameToRGBA(const AVFrame *frame, RGBAOrder order, Uint8 *dst, int dstStride)
+{
+    YUVImage image;
+    switch (frame->format) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+            image.interleavedChroma = false;
+            break;
+        case AV_PIX_FMT_NV12:
+            image.interleavedChroma = true;
+            break;
+        default:
+            return false;
+    }
+    for (int plane = 0; plane < 3; ++plane) {
+        image.planes[plane] = frame->data[plane];
+        image.strides[plane] = frame->linesize[plane];
+    }
+    image.width = frame->width;
+    image.height = frame->height;
+    convertYUVToRGBA(image, frameYUVMatrix(frame), order, dst, dstStride);
+    return true;
+}
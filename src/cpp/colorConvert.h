@@ -0,0 +1,53 @@
+#ifndef COLOR_CONVERT_H
+#define COLOR_CONVERT_H
+
+#include <string>
+#include <SDL3/SDL.h>
+
+extern "C"
+{
+    #include <libavutil/frame.h>
+}
+
+//Built-in YUV 4:2:0 to 32-bit RGB conversion with SSE2, AVX2 and NEON
+//kernels, for the RGB_CONVERT path where sws_scale was doing an identity-size
+//convert. Every kernel produces bit-identical output to the scalar one.
+enum class YUVMatrix
+{
+    BT601_LIMITED,
+    BT601_FULL,
+    BT709_LIMITED,
+    BT709_FULL
+};
+
+//Byte order in memory: RGBA matches SDL_PIXELFORMAT_RGBA32, BGRA matches
+//SDL_PIXELFORMAT_BGRA32
+enum class RGBAOrder
+{
+    RGBA,
+    BGRA
+};
+
+struct YUVImage
+{
+    const Uint8 *planes[3] = { nullptr, nullptr, nullptr };
+    int strides[3] = { 0, 0, 0 };
+    int width = 0;
+    int height = 0;
+    bool interleavedChroma = false;     //NV12: planes[1] holds UVUV...
+};
+
+void convertYUVToRGBA(const YUVImage &image, YUVMatrix matrix, RGBAOrder order, Uint8 *dst, int dstStride);
+
+//YUV420P, YUVJ420P and NV12 frames, using the frame's own colorspace and
+//range. Returns false for any other format.
+bool convertFrameToRGBA(const AVFrame *frame, RGBAOrder order, Uint8 *dst, int dstStride);
+YUVMatrix frameYUVMatrix(const AVFrame *frame);
+
+//The kernel is picked on first use from the CPU's features, or forced with
+//ATARAXIA_COLOR_KERNEL=scalar|sse2|avx2|neon
+const char* getColorConvertKernelName();
+//Returns false if the kernel isn't built for or supported by this CPU
+bool setColorConvertKernel(const std::string &name);
+
+#endif
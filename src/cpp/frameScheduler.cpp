@@ -0,0 +1,123 @@
+#include "frameScheduler.h"
+
+#include <algorithm>
+
+//A gap this long means the loop was idle, not that a frame ran late
+constexpr Uint64 MaxFrameIntervalNS = SDL_NS_PER_SECOND / 4;
+
+void initFrameScheduler(FrameScheduler &scheduler, SDL_Renderer *renderer)
+{
+    scheduler = FrameScheduler();
+
+    int fps = DefaultTargetFPS;
+    if (const char *value = SDL_getenv("ATARAXIA_TARGET_FPS")) {
+        int requested = SDL_atoi(value);
+        if (requested > 0) fps = std::min(requested, 1000);
+    }
+    scheduler.framePeriodNS = SDL_NS_PER_SECOND / static_cast<Uint64>(fps);
+
+    const char *vsync = SDL_getenv("ATARAXIA_VSYNC");
+    bool wantVsync = !(vsync && SDL_atoi(vsync) == 0);
+    if (wantVsync) {
+        scheduler.vsync = SDL_SetRenderVSync(renderer, 1);
+        if (!scheduler.vsync) SDL_Log("VSync unavailable, pacing to %d fps: %s", fps, SDL_GetError());
+    } else {
+        SDL_SetRenderVSync(renderer, 0);
+    }
+    SDL_Log("Frame scheduler: %s", scheduler.vsync ? "vsync" : "timer paced");
+}
+
+void markFrameDirty(FrameScheduler &scheduler)
+{
+    scheduler.dirty = true;
+}
+
+void setFrameAnimating(FrameScheduler &scheduler, bool animating)
+{
+    scheduler.animating = animating;
+}
+
+void scheduleFrameAt(FrameScheduler &scheduler, Uint64 ticksNS)
+{
+    if (scheduler.deadlineNS == 0 || ticksNS < scheduler.deadlineNS) {
+        scheduler.deadlineNS = std::max<Uint64>(ticksNS, 1);
+    }
+}
+
+//When the next frame is wanted, or 0 when only input can cause one
+static Uint64 nextWakeNS(const FrameScheduler &scheduler)
+{
+    Uint64 wake = scheduler.deadlineNS;
+    if (scheduler.animating) {
+        //With vsync the present itself does the waiting
+        Uint64 paced = scheduler.vsync ? 1 : scheduler.lastFrameNS + scheduler.framePeriodNS;
+        wake = wake ? std::min(wake, paced) : paced;
+    }
+    return wake;
+}
+
+void waitForNextFrame(FrameScheduler &scheduler)
+{
+    if (scheduler.dirty) return;
+
+    Uint64 start = SDL_GetTicksNS();
+    Uint64 wake = nextWakeNS(scheduler);
+    if (wake != 0 && wake <= start) return;
+
+    bool gotEvent;
+    if (wake == 0) {
+        gotEvent = SDL_WaitEvent(nullptr);
+    } else {
+        //Rounded up, waking a little late beats spinning on an early wake
+        Uint64 waitNS = wake - start;
+        Sint32 waitMS = static_cast<Sint32>((waitNS + SDL_NS_PER_MS - 1) / SDL_NS_PER_MS);
+        gotEvent = SDL_WaitEventTimeout(nullptr, waitMS);
+    }
+    if (gotEvent) {
+        ++scheduler.stats.eventWakeups;
+    } else {
+        ++scheduler.stats.deadlineWakeups;
+    }
+    scheduler.stats.idleNS += SDL_GetTicksNS() - start;
+}
+
+bool shouldRenderFrame(const FrameScheduler &scheduler)
+{
+    if (scheduler.dirty) return true;
+    Uint64 wake = nextWakeNS(scheduler);
+    return wake != 0 && SDL_GetTicksNS() >= wake;
+}
+
+void frameRendered(FrameScheduler &scheduler)
+{
+    Uint64 now = SDL_GetTicksNS();
+    bool continuous = scheduler.animating || scheduler.deadlineNS != 0;
+    if (continuous && scheduler.followingDeadlines && scheduler.lastFrameNS != 0) {
+        Uint64 interval = now - scheduler.lastFrameNS;
+        if (interval < MaxFrameIntervalNS) {
+            FrameSchedulerStats &stats = scheduler.stats;
+            stats.intervalMinNS = stats.intervals ? std::min(stats.intervalMinNS, interval) : interval;
+            stats.intervalMaxNS = std::max(stats.intervalMaxNS, interval);
+            stats.intervalTotalNS += interval;
+            ++stats.intervals;
+        }
+    }
+    scheduler.followingDeadlines = continuous;
+    ++scheduler.stats.framesRendered;
+    scheduler.dirty = false;
+    scheduler.deadlineNS = 0;
+    scheduler.lastFrameNS = now;
+}
+
+void logFrameSchedulerStats(const FrameScheduler &scheduler)
+{
+    const FrameSchedulerStats &stats = scheduler.stats;
+    double average = stats.intervals ? static_cast<double>(stats.intervalTotalNS) / stats.intervals : 0.0;
+    SDL_Log("Frame scheduler: %llu frames, %llu event / %llu deadline wakeups, %.1f s idle, "
+            "frame interval %.2f/%.2f/%.2f ms (min/avg/max)",
+            static_cast<unsigned long long>(stats.framesRendered),
+            static_cast<unsigned long long>(stats.eventWakeups),
+            static_cast<unsigned long long>(stats.deadlineWakeups),
+            static_cast<double>(stats.idleNS) / SDL_NS_PER_SECOND,
+            stats.intervalMinNS / 1000000.0, average / 1000000.0, stats.intervalMaxNS / 1000000.0);
+}
@@ -0,0 +1,59 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <SDL3/SDL.h>
+
+//Pacing used when vsync is off or unavailable
+constexpr int DefaultTargetFPS = 60;
+
+struct FrameSchedulerStats
+{
+    Uint64 framesRendered = 0;
+    Uint64 eventWakeups = 0;
+    Uint64 deadlineWakeups = 0;
+    Uint64 idleNS = 0;          //time spent blocked waiting for work
+    //Between consecutive frames while animating or following deadlines
+    Uint64 intervals = 0;
+    Uint64 intervalTotalNS = 0;
+    Uint64 intervalMinNS = 0;
+    Uint64 intervalMaxNS = 0;
+};
+
+//Decides when the main loop renders. A clean, still scene blocks in SDL's
+//event wait until input arrives; a scene with something due later (the
+//next video frame) sleeps until that deadline; an animating scene renders
+//every vsync, or at the target rate when vsync is off.
+struct FrameScheduler
+{
+    bool vsync = false;
+    Uint64 framePeriodNS = SDL_NS_PER_SECOND / DefaultTargetFPS;
+    bool dirty = true;          //the first frame always renders
+    bool animating = false;
+    Uint64 deadlineNS = 0;      //0 when nothing is due
+    Uint64 lastFrameNS = 0;
+    bool followingDeadlines = false;
+    FrameSchedulerStats stats;
+};
+
+//Turns vsync on unless ATARAXIA_VSYNC=0. ATARAXIA_TARGET_FPS sets the pacer
+//used without vsync.
+void initFrameScheduler(FrameScheduler &scheduler, SDL_Renderer *renderer);
+
+//Something visible changed, render once as soon as possible
+void markFrameDirty(FrameScheduler &scheduler);
+//Render continuously, paced by vsync or the target rate
+void setFrameAnimating(FrameScheduler &scheduler, bool animating);
+//Render once no later than ticksNS (SDL_GetTicksNS time). The earliest
+//deadline requested since the last frame wins.
+void scheduleFrameAt(FrameScheduler &scheduler, Uint64 ticksNS);
+
+//Blocks until there is input to handle or a frame to render. Events are
+//left queued for the caller to poll.
+void waitForNextFrame(FrameScheduler &scheduler);
+bool shouldRenderFrame(const FrameScheduler &scheduler);
+//Call after presenting; clears the dirty flag and the deadline
+void frameRendered(FrameScheduler &scheduler);
+
+void logFrameSchedulerStats(const FrameScheduler &scheduler);
+
+#endif
@@ -0,0 +1,240 @@
+#include "glyphAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+struct GlyphAtlasCache
+{
+    std::vector<GlyphAtlas*> atlases;
+    GlyphAtlasStats stats;
+};
+
+static GlyphAtlasCache glyphAtlasCache;
+
+//Starts an empty page. Glyph metrics are kept, only residency is lost.
+static bool createPage(GlyphAtlas *atlas, int size)
+{
+    if (atlas->texture) SDL_DestroyTexture(atlas->texture);
+    atlas->texture = SDL_CreateTexture(atlas->renderer, SDL_PIXELFORMAT_RGBA32,
+                                       SDL_TEXTUREACCESS_STATIC, size, size);
+    if (!atlas->texture) {
+        SDL_Log("Failed to create %dx%d glyph atlas: %s", size, size, SDL_GetError());
+        atlas->size = 0;
+        return false;
+    }
+    SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+    //Static textures start out undefined, the padding has to be transparent
+    std::vector<Uint32> clear(static_cast<size_t>(size) * size, 0);
+    SDL_UpdateTexture(atlas->texture, nullptr, clear.data(), size * 4);
+
+    atlas->size = size;
+    atlas->penX = GlyphAtlasPadding;
+    atlas->penY = GlyphAtlasPadding;
+    atlas->rowHeight = 0;
+    for (auto &entry : atlas->glyphs) {
+        entry.second.resident = false;
+    }
+    return true;
+}
+
+static AtlasGlyph& measureGlyph(GlyphAtlas *atlas, Uint32 codepoint)
+{
+    auto found = atlas->glyphs.find(codepoint);
+    if (found != atlas->glyphs.end()) return found->second;
+
+    AtlasGlyph &glyph = atlas->glyphs[codepoint];
+    int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+    if (!TTF_GetGlyphMetrics(atlas->font, codepoint, &minX, &maxX, &minY, &maxY, &advance)) {
+        glyph.blank = true;
+        return glyph;
+    }
+    //TTF shifts a cell right by any overhang to the left of the pen
+    glyph.offsetX = static_cast<float>(std::min(0, minX));
+    glyph.advance = static_cast<float>(advance);
+    glyph.blank = maxX <= minX;
+    return glyph;
+}
+
+//Returns false only when the page has no room left for the glyph
+static bool rasterizeGlyph(GlyphAtlas *atlas, Uint32 codepoint, AtlasGlyph &glyph)
+{
+    if (glyph.blank) {
+        glyph.resident = true;
+        return true;
+    }
+
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface *cell = TTF_RenderGlyph_Blended(atlas->font, codepoint, white);
+    if (cell && cell->format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_Surface *converted = SDL_ConvertSurface(cell, SDL_PIXELFORMAT_RGBA32);
+        SDL_DestroySurface(cell);
+        cell = converted;
+    }
+    if (!cell) {
+        SDL_Log("Failed to rasterize glyph U+%04X: %s", codepoint, SDL_GetError());
+        glyph.blank = true;
+        glyph.resident = true;
+        return true;
+    }
+
+    if (atlas->penX + cell->w + GlyphAtlasPadding > atlas->size) {
+        atlas->penX = GlyphAtlasPadding;
+        atlas->penY += atlas->rowHeight + GlyphAtlasPadding;
+        atlas->rowHeight = 0;
+    }
+    if (cell->w + 2 * GlyphAtlasPadding > atlas->size ||
+        atlas->penY + cell->h + GlyphAtlasPadding > atlas->size) {
+        SDL_DestroySurface(cell);
+        return false;
+    }
+
+    SDL_Rect rect = {atlas->penX, atlas->penY, cell->w, cell->h};
+    SDL_UpdateTexture(atlas->texture, &rect, cell->pixels, cell->pitch);
+    glyph.src = {static_cast<float>(rect.x), static_cast<float>(rect.y),
+                 static_cast<float>(rect.w), static_cast<float>(rect.h)};
+    glyph.resident = true;
+    atlas->penX += cell->w + GlyphAtlasPadding;
+    atlas->rowHeight = std::max(atlas->rowHeight, cell->h);
+    SDL_DestroySurface(cell);
+    ++glyphAtlasCache.stats.glyphsRasterized;
+    return true;
+}
+
+//Rasterizes whatever the layout needs that isn't on the page yet. A full
+//page is regrown (or, at max size, started over) and the layout retried;
+//quads already batched from the old page are submitted before it goes.
+static bool makeResident(GlyphAtlas *atlas, RenderBatch &batch, const AtlasTextLayout &layout)
+{
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        bool full = false;
+        for (const AtlasGlyphPlacement &placed : layout.glyphs) {
+            AtlasGlyph &glyph = atlas->glyphs[placed.codepoint];
+            if (!glyph.resident && !rasterizeGlyph(atlas, placed.codepoint, glyph)) {
+                full = true;
+                break;
+            }
+        }
+        if (!full) return true;
+        flushRenderBatch(batch);
+        if (!createPage(atlas, std::min(atlas->size * 2, GlyphAtlasMaxSize))) return false;
+        ++glyphAtlasCache.stats.pageRebuilds;
+    }
+    SDL_Log("Glyph atlas: text needs more glyphs than fit in a %dx%d page",
+            GlyphAtlasMaxSize, GlyphAtlasMaxSize);
+    return false;
+}
+
+static const AtlasTextLayout* layoutText(GlyphAtlas *atlas, const char *text)
+{
+    //Reused key buffer, so a cached string doesn't allocate to be looked up
+    atlas->layoutKey.assign(text);
+    auto found = atlas->layouts.find(atlas->layoutKey);
+    if (found != atlas->layouts.end()) {
+        ++glyphAtlasCache.stats.layoutHits;
+        return &found->second;
+    }
+    ++glyphAtlasCache.stats.layoutMisses;
+    if (atlas->layouts.size() >= GlyphAtlasMaxLayouts) atlas->layouts.clear();
+
+    AtlasTextLayout &layout = atlas->layouts[atlas->layoutKey];
+    size_t remaining = std::strlen(text);
+    float pen = 0.0f;
+    Uint32 previous = 0;
+    while (remaining > 0) {
+        Uint32 codepoint = SDL_StepUTF8(&text, &remaining);
+        if (codepoint == 0) break;
+        int kerning = 0;
+        if (previous && TTF_GetGlyphKerning(atlas->font, previous, codepoint, &kerning)) {
+            pen += static_cast<float>(kerning);
+        }
+        const AtlasGlyph &glyph = measureGlyph(atlas, codepoint);
+        layout.glyphs.push_back({codepoint, pen + glyph.offsetX});
+        pen += glyph.advance;
+        previous = codepoint;
+    }
+    layout.width = pen;
+    layout.height = atlas->lineHeight;
+    return &layout;
+}
+
+GlyphAtlas* getGlyphAtlas(SDL_Renderer *renderer, TTF_Font *font)
+{
+    if (!renderer || !font) return nullptr;
+
+    float fontSize = TTF_GetFontSize(font);
+    for (GlyphAtlas *atlas : glyphAtlasCache.atlases) {
+        if (atlas->renderer == renderer && atlas->font == font && atlas->fontSize == fontSize) {
+            return atlas;
+        }
+    }
+
+    GlyphAtlas *atlas = new GlyphAtlas();
+    atlas->renderer = renderer;
+    atlas->font = font;
+    atlas->fontSize = fontSize;
+    atlas->lineHeight = static_cast<float>(TTF_GetFontHeight(font));
+    if (!createPage(atlas, GlyphAtlasInitialSize)) {
+        delete atlas;
+        return nullptr;
+    }
+    glyphAtlasCache.atlases.push_back(atlas);
+    return atlas;
+}
+
+void destroyGlyphAtlases()
+{
+    for (GlyphAtlas *atlas : glyphAtlasCache.atlases) {
+        if (atlas->texture) SDL_DestroyTexture(atlas->texture);
+        delete atlas;
+    }
+    glyphAtlasCache.atlases.clear();
+}
+
+bool drawAtlasText(GlyphAtlas *atlas, RenderBatch &batch, const char *text,
+                   float x, float y, SDL_Color color)
+{
+    if (!atlas || !text) return false;
+
+    const AtlasTextLayout *layout = layoutText(atlas, text);
+    if (!makeResident(atlas, batch, *layout)) return false;
+
+    for (const AtlasGlyphPlacement &placed : layout->glyphs) {
+        const AtlasGlyph &glyph = atlas->glyphs[placed.codepoint];
+        if (glyph.blank) continue;
+        SDL_FRect dst = {x + placed.x, y, glyph.src.w, glyph.src.h};
+        batchTexture(batch, atlas->texture, &glyph.src, &dst, color);
+        ++glyphAtlasCache.stats.quadsDrawn;
+    }
+    return true;
+}
+
+bool measureAtlasText(GlyphAtlas *atlas, const char *text, float &width, float &height)
+{
+    if (!atlas || !text) return false;
+    const AtlasTextLayout *layout = layoutText(atlas, text);
+    width = layout->width;
+    height = layout->height;
+    return true;
+}
+
+GlyphAtlasStats getGlyphAtlasStats()
+{
+    return glyphAtlasCache.stats;
+}
+
+void logGlyphAtlasStats()
+{
+    GlyphAtlasStats stats = glyphAtlasCache.stats;
+    int pageSize = 0;
+    for (GlyphAtlas *atlas : glyphAtlasCache.atlases) {
+        pageSize = std::max(pageSize, atlas->size);
+    }
+    SDL_Log("Glyph atlas: %zu atlases (largest %dx%d), %llu glyphs rasterized, %llu rebuilds, "
+            "%llu/%llu layout hits, %llu quads drawn",
+            glyphAtlasCache.atlases.size(), pageSize, pageSize,
+            static_cast<unsigned long long>(stats.glyphsRasterized),
+            static_cast<unsigned long long>(stats.pageRebuilds),
+            static_cast<unsigned long long>(stats.layoutHits),
+            static_cast<unsigned long long>(stats.layoutHits + stats.layoutMisses),
+            static_cast<unsigned long long>(stats.quadsDrawn));
+}
@@ -0,0 +1,89 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <SDL3/SDL.h>
+#include <SDL3_ttf/SDL_ttf.h>
+
+#include "renderBatch.h"
+
+//Atlas pages start at this size and double, up to the max, when they fill
+constexpr int GlyphAtlasInitialSize = 256;
+constexpr int GlyphAtlasMaxSize = 2048;
+//Empty texels kept around each glyph so filtering never picks up a neighbour
+constexpr int GlyphAtlasPadding = 1;
+//Laid out strings remembered per atlas before the cache starts over
+constexpr size_t GlyphAtlasMaxLayouts = 128;
+
+//Where one rasterized glyph lives in the atlas. Glyphs are stored as the
+//cell TTF renders them in, one line tall with the baseline at the ascent.
+struct AtlasGlyph
+{
+    SDL_FRect src = {0.0f, 0.0f, 0.0f, 0.0f};
+    float offsetX = 0.0f;       //cell left edge relative to the pen
+    float advance = 0.0f;
+    bool blank = false;         //nothing to draw (space, missing glyph)
+    bool resident = false;      //false until rasterized into the current page
+};
+
+struct AtlasGlyphPlacement
+{
+    Uint32 codepoint = 0;
+    float x = 0.0f;             //cell left edge, kerning already applied
+};
+
+//A string shaped once: codepoints with their pen positions
+struct AtlasTextLayout
+{
+    std::vector<AtlasGlyphPlacement> glyphs;
+    float width = 0.0f;
+    float height = 0.0f;
+};
+
+//Every glyph of one (font, size) rasterized once in white into a single
+//texture; text is tinted through its vertex colors when drawn.
+struct GlyphAtlas
+{
+    SDL_Renderer *renderer = nullptr;
+    TTF_Font *font = nullptr;
+    float fontSize = 0.0f;
+    float lineHeight = 0.0f;
+    SDL_Texture *texture = nullptr;
+    int size = 0;
+    //Shelf packer: glyphs fill rows left to right, rows stack downwards
+    int penX = 0;
+    int penY = 0;
+    int rowHeight = 0;
+    std::unordered_map<Uint32, AtlasGlyph> glyphs;
+    std::unordered_map<std::string, AtlasTextLayout> layouts;
+    std::string layoutKey;
+};
+
+struct GlyphAtlasStats
+{
+    Uint64 glyphsRasterized = 0;
+    Uint64 pageRebuilds = 0;    //atlas grew, or filled at max size and started over
+    Uint64 layoutHits = 0;
+    Uint64 layoutMisses = 0;
+    Uint64 quadsDrawn = 0;
+};
+
+//Returns the atlas for font at its current size, creating it on first use.
+//Atlases live until destroyGlyphAtlases(), which must run before the
+//renderer or any of the fonts are destroyed.
+GlyphAtlas* getGlyphAtlas(SDL_Renderer *renderer, TTF_Font *font);
+void destroyGlyphAtlases();
+
+//Adds UTF-8 text with its top-left corner at (x, y) to the batch. Glyphs
+//not seen before are rasterized into the atlas first; after that a string
+//costs one quad per visible glyph and no uploads.
+bool drawAtlasText(GlyphAtlas *atlas, RenderBatch &batch, const char *text,
+                   float x, float y, SDL_Color color);
+bool measureAtlasText(GlyphAtlas *atlas, const char *text, float &width, float &height);
+
+GlyphAtlasStats getGlyphAtlasStats();
+void logGlyphAtlasStats();
+
+#endif
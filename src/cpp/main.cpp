@@ -14,12 +14,23 @@ Author: Ryan Wiseman
 #include <sqlite3.h>
 #include <iostream>
 #include <array>
+#include <algorithm>
 
 //App headers
 #include "gameScores.h"
 #include "SDLColors.h"
 #include "screenScenes.h"
 #include "videoRendering.h"
+#include "videoDecoder.h"
+#include "videoCache.h"
+#include "videoPrefetch.h"
+#include "allocationCounter.h"
+#include "audioEngine.h"
+#include "glyphAtlas.h"
+#include "renderBatch.h"
+#include "sdfFont.h"
+#include "frameScheduler.h"
+#include "renderLayer.h"
 
 extern "C" {
     #include <libavcodec/avcodec.h>
@@ -31,11 +42,24 @@ extern "C" {
 SDL_Window *window;
 SDL_Renderer *renderer;
 TTF_Font* font;
+// Every text size is drawn from this one field, the TTF font is the fallback
+SdfFont sdfFont;
+bool sdfFontLoaded = false;
 VideoState video;
+// Everything render() draws goes through here, one submission per texture
+RenderBatch frameBatch;
+FrameScheduler frameScheduler;
+// Still scenes are drawn once into these and composited every frame
+RenderLayer menuLayer{"menu"};
+RenderLayer boardLayer{"board"};
 
 constexpr int ScreenWidth = 600;
 constexpr int ScreenHeight = 600;
 constexpr int SprightSize = 200;
+constexpr float TextPixelSize = 50.0f;
+// Short looping clips are kept decoded in memory up to this budget
+constexpr size_t VideoCacheBudget = 64 * 1024 * 1024;
+constexpr double VideoCacheMaxDuration = 10.0;
 
 enum class Player { NONE, X, O };
 
@@ -50,21 +74,28 @@ int scorePlayer2 = 0;
 int player1WinCount = 0;
 int player2WinCount = 0;
 
-bool audioInitialized = false;
-bool newPlacementMade = false;
+static int blipSound = -1;
 
 SceneState currentScene = SceneState::MAIN_MENU;
 
 static bool videoInitialized;
+static VideoPrefetch videoPrefetch;
+
+// A player this close to winning makes END_SCREEN likely, start opening it
+constexpr int WinsToEndScreen = 3;
+constexpr int WinsToPrefetch = 2;
 
 //Function prototypes
 bool init();
 bool initAudio(VideoState &video);
 bool initMP4(const std::string &filename, VideoState &video);
+bool openEndScreenVideo(VideoState &video);
+void prefetchEndScreen();
 void render();
+void scheduleVideoFrame();
 void renderText(const char* message, int x, int y, SDL_Color color);
-SDL_Texture* getNextFrame(VideoState &video, SDL_Renderer* renderer);
 void handleEvents(bool& done);
+void logPerformanceStats();
 bool checkWin(Player player);
 void resetBoard();
 void close();
@@ -75,6 +106,8 @@ int main(int argc, char* argv[]) {
     (void)argc;
     (void)argv;
     
+    // Has to see SDL's very first allocation, so it goes before init()
+    installAllocationCounter();
     if (!init()) {
         SDL_Log("Unable to initialize program!\n");
         return 1;
@@ -92,13 +125,28 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Main loop for window event handling
+    // Main loop: sleeps until there is input or the next video frame is due,
+    // so still scenes are only redrawn when something changes
+    initFrameScheduler(frameScheduler, renderer);
     while (!done) {
+        waitForNextFrame(frameScheduler);
         handleEvents(done);
-        render();
+        if (!done && shouldRenderFrame(frameScheduler)) {
+            render();
+            frameRendered(frameScheduler);
+            scheduleVideoFrame();
+        }
     }
 
     // Cleanup
+    finishVideoPrefetch(videoPrefetch);
+    logPerformanceStats();
+    closeVideo(video);
+    clearVideoCache();
+    shutdownAudioEngine();
+    destroyRenderLayers();
+    destroyGlyphAtlases();
+    closeSdfFont(sdfFont);
     SDL_DestroyWindow(window);
     SDL_Quit();
 
@@ -124,17 +172,43 @@ bool init()
         return false;
     }
 
+    configureVideoCache(VideoCacheBudget, VideoCacheMaxDuration);
+
+    // Sound effects are decoded once here and mixed from memory on every play
+    if (initAudioEngine()) {
+        blipSound = loadSoundEffect("blip", "assets/audio/blip.wav");
+    } else {
+        SDL_Log("Proceeding without sound effects");
+    }
+
     std::string fontPath = "assets/fonts/ArianaVioleta.ttf";
-    font = TTF_OpenFont(fontPath.c_str(), 50);
-    if (!font) {
-        SDL_Log("Cannot load font!");
+    // The shipped cache comes from make sdf-cache; if it's missing or stale
+    // the font is baked once and kept in the user's preferences directory,
+    // the assets may be read-only inside the app bundle
+    std::string rebakePath;
+    if (char* prefPath = SDL_GetPrefPath("Ataraxia", "AtaraxiaSDK")) {
+        rebakePath = std::string(prefPath) + "ArianaVioleta.sdf";
+        SDL_free(prefPath);
+    } else {
+        SDL_Log("No preferences directory, a rebaked font won't be kept: %s", SDL_GetError());
+    }
+    sdfFontLoaded = loadSdfFont(sdfFont, "assets/fonts/ArianaVioleta.sdf", rebakePath, fontPath);
+    if (!sdfFontLoaded) {
+        font = TTF_OpenFont(fontPath.c_str(), TextPixelSize);
+        if (!font) {
+            SDL_Log("Cannot load font!");
+        }
     }
 
     return true;
 }
 
 bool initMP4(const std::string &filename, VideoState &video) {
-    if (loadMP4(filename, video)) {
+    // The video is drawn over the whole window, so never decode or upload more
+    VideoDecodeOptions options = videoDecodeOptionsFromEnvironment();
+    options.targetWidth = ScreenWidth;
+    options.targetHeight = ScreenHeight;
+    if (loadMP4(filename, video, options)) {
         std::cout << "MP4 file loaded successfully: " << filename << std::endl;
         std::cout << "Video Stream Index: " << video.videoStream << std::endl;
         std::cout << "Codec: " << video.pCodec->name << std::endl;
@@ -146,272 +220,181 @@ bool initMP4(const std::string &filename, VideoState &video) {
     }
 }
 
+// Runs on the prefetch worker
+bool openEndScreenVideo(VideoState &video) {
+    if (!initMP4("assets/video/CatSpin.mp4", video)) {
+        return false;
+    }
+    video.cacheEnabled = true;
+    if (video.audioStreamIndex >= 0 && !initAudio(video)) {
+        SDL_Log("Playing video without sound");
+    }
+    return true;
+}
+
+void prefetchEndScreen() {
+    if (!videoInitialized && !isVideoPrefetchStarted(videoPrefetch)) {
+        startVideoPrefetch(videoPrefetch, video, openEndScreenVideo);
+    }
+}
+
 bool initAudio(VideoState &video) {
-    SDL_AudioSpec wantedSpec, obtainedSpec;
-    SDL_zero(wantedSpec); 
-    wantedSpec.freq = 44100;
-    wantedSpec.format = SDL_AUDIO_S16;
-    wantedSpec.channels = 2;
-    
-    video.audioDevice = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &wantedSpec);
-    if (video.audioDevice == 0) {
-        SDL_Log("Error: Could not open audio device: %s", SDL_GetError());
+    // The soundtrack plays through the audio engine's device alongside the
+    // sound effects, never a device of its own
+    SDL_AudioDeviceID device = getAudioEngineDevice();
+    if (device == 0) {
+        SDL_Log("Error: No audio engine device for the video soundtrack");
+        return false;
+    }
+    SDL_AudioSpec deviceSpec;
+    if (!SDL_GetAudioDeviceFormat(device, &deviceSpec, nullptr)) {
+        SDL_Log("Error: Could not query audio device: %s", SDL_GetError());
+        return false;
+    }
+
+    // The decoder resamples straight to the device rate and layout as S16
+    video.audioDevice = device;
+    video.audioSpec = deviceSpec;
+    video.audioSpec.format = SDL_AUDIO_S16;
+    if (!openVideoAudio(video)) {
+        video.audioDevice = 0;
         return false;
     }
-    
-    video.audioSpec = obtainedSpec;
-    SDL_ResumeAudioDevice(video.audioDevice);
     return true;
 }
 
 void render() {
-    static SDL_Texture* videoTexture = nullptr;
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
     SDL_RenderClear(renderer);
+    beginRenderBatch(frameBatch, renderer);
     
+    const SDL_FRect screenRect { 0.0f, 0.0f, static_cast<float>(ScreenWidth), static_cast<float>(ScreenHeight) };
     if (currentScene == SceneState::MAIN_MENU) {
-        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-        SDL_RenderFillRect(renderer, nullptr);
-        renderText("Cat Tac Toe", 225, 250, cMagenta);
-        videoInitialized = false;
-        audioInitialized = false;  
+        if (beginRenderLayer(menuLayer, frameBatch, ScreenWidth, ScreenHeight)) {
+            batchFillRect(frameBatch, screenRect, cRed);
+            renderText("Cat Tac Toe", 225, 250, cMagenta);
+            endRenderLayer(menuLayer, frameBatch);
+        }
+        compositeRenderLayer(menuLayer, frameBatch, screenRect);
     } 
     else if (currentScene == SceneState::GAME) {
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        for (int i = 1; i < 3; i++) {
-            SDL_RenderLine(renderer, i * SprightSize, 0, i * SprightSize, ScreenHeight);
-            SDL_RenderLine(renderer, 0, i * SprightSize, ScreenWidth, i * SprightSize);
-        }
+        // The board only changes on a click, redrawn into its layer then
+        if (beginRenderLayer(boardLayer, frameBatch, ScreenWidth, ScreenHeight)) {
+            for (int i = 1; i < 3; i++) {
+                batchLine(frameBatch, i * SprightSize, 0, i * SprightSize, ScreenHeight, cBlack);
+                batchLine(frameBatch, 0, i * SprightSize, ScreenWidth, i * SprightSize, cBlack);
+            }
 
-        for (int row = 0; row < 3; ++row) {
-            for (int col = 0; col < 3; ++col) {
-                int x = col * SprightSize;
-                int y = row * SprightSize;
-
-                if (board[row][col] == Player::X) {
-                    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-                    SDL_RenderLine(renderer, x + SprightSize - 20, y + 20, x + 20, y + SprightSize - 20);
-                    SDL_RenderLine(renderer, x + 20, y + 20, x + SprightSize - 20, y + SprightSize - 20);
-
-                    if (!audioInitialized) {
-                        std::string audioPath = "assets/audio/blip.wav";
-                        SDL_Log("Attempting to load audio from: %s", audioPath.c_str());
-                        if (loadAudioFile(audioPath)) {
-                            SDL_Log("Audio file loaded successfully, attempting playback...");
-                            audioInitialized = true;
-                        } else {
-                            SDL_Log("Failed to load audio file, proceeding without sound.");
-                        }
-                    }
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 3; ++col) {
+                    int x = col * SprightSize;
+                    int y = row * SprightSize;
 
-                    if (newPlacementMade && audioInitialized) {
-                        playSFX();
-                        newPlacementMade = false;
+                    if (board[row][col] == Player::X) {
+                        batchLine(frameBatch, x + SprightSize - 20, y + 20, x + 20, y + SprightSize - 20, cRed);
+                        batchLine(frameBatch, x + 20, y + 20, x + SprightSize - 20, y + SprightSize - 20, cRed);
                     }
-                }
-                else if (board[row][col] == Player::O) {
-                    SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
-                    SDL_FRect rect {
-                        static_cast<float>(x + 20), 
-                        static_cast<float>(y + 20),
-                        static_cast<float>(SprightSize - 40), 
-                        static_cast<float>(SprightSize - 40)
-                    };
-                    SDL_RenderRect(renderer, &rect);
-                    if (!audioInitialized) {
-                        std::string audioPath = "assets/audio/blip.wav";
-                        SDL_Log("Attempting to load audio from: %s", audioPath.c_str());
-                        if (loadAudioFile(audioPath)) {
-                            SDL_Log("Audio file loaded successfully, attempting playback...");
-                            playAudio();
-                            audioInitialized = true;
-                        } else {
-                            SDL_Log("Failed to load audio file, proceeding without sound.");
-                        }
-                    }
-
-                    if (newPlacementMade && audioInitialized) {
-                        playSFX();
-                        newPlacementMade = false;
+                    else if (board[row][col] == Player::O) {
+                        SDL_FRect rect {
+                            static_cast<float>(x + 20), 
+                            static_cast<float>(y + 20),
+                            static_cast<float>(SprightSize - 40), 
+                            static_cast<float>(SprightSize - 40)
+                        };
+                        batchRect(frameBatch, rect, cBlue);
                     }
                 }
             }
+            endRenderLayer(boardLayer, frameBatch);
         }
+        compositeRenderLayer(boardLayer, frameBatch, screenRect);
     }
     else if (currentScene == SceneState::END_SCREEN) {
-        static uint32_t lastFrameTime = SDL_GetTicks();
-        static double videoAccumulator = 0.0;
-        static double frameDelay = 33.333333333333333;   
-    
         if (!videoInitialized) {
-            std::string mp4File = "assets/video/CatSpin.mp4";
-            if (!initMP4(mp4File, video)) {
+            // Normally already opened while the game was running, otherwise
+            // this opens it now and waits
+            prefetchEndScreen();
+            if (!finishVideoPrefetch(videoPrefetch)) {
                 SDL_Log("Failed to initialize video");
                 currentScene = SceneState::MAIN_MENU;
+                markFrameDirty(frameScheduler);
                 return;
             }
-            if (video.pFormatCtx && video.videoStream >= 0) {
-                AVStream* stream = video.pFormatCtx->streams[video.videoStream];
-                if (stream->avg_frame_rate.den != 0 && stream->avg_frame_rate.num != 0) {
-                    frameDelay = (1000.0 * stream->avg_frame_rate.den) / stream->avg_frame_rate.num;
-                    SDL_Log("Updated Video Frame Delay: %.6f ms", frameDelay);
-                }
-            }
-            lastFrameTime = SDL_GetTicks();
-            videoAccumulator = 0.0;
+            SDL_Log("Video frame duration: %.6f ms", video.frameDuration * 1000.0);
             videoInitialized = true;
-            audioInitialized = false;
         }
+        resumeVideo(video);
         
-        if (!audioInitialized) {
-                std::string audioPath = "assets/video/CatSpin.wav";
-                SDL_Log("Attempting to load audio from: %s", audioPath.c_str());
-                if (loadAudioFile(audioPath)) {
-                    SDL_Log("Audio file loaded successfully, attempting playback...");
-                    playAudio();
-                    audioInitialized = true;
-                    SDL_Log("Audio initialized and playing!");
-                }
-            else {
-                SDL_Log("Failed to initialize audio device.");
-            }
-        }
-        
-        
-        uint32_t currentTime = SDL_GetTicks();
-        double deltaTime = static_cast<double>(currentTime - lastFrameTime);
-        lastFrameTime = currentTime;
-        videoAccumulator += deltaTime;
-        
-        if (videoAccumulator >= frameDelay) {
-            SDL_Texture* nextFrame = getNextFrame(video, renderer);
-            if (nextFrame) {
-                if (videoTexture) {
-                    SDL_DestroyTexture(videoTexture);
-                }
-                videoTexture = nextFrame;
-            }
-            videoAccumulator -= frameDelay;
+        // The clip's soundtrack is the master clock while it plays,
+        // otherwise the clock free-runs
+        double audioTime = 0.0;
+        if (getVideoAudioClock(video, audioTime)) {
+            syncPlaybackClock(video.clock, audioTime);
         }
+        presentVideoFrame(video, renderer, getPlaybackClock(video.clock));
         
-        if (videoTexture) {
-            SDL_RenderTexture(renderer, videoTexture, nullptr, nullptr);
+        if (video.videoTexture) {
+            batchTexture(frameBatch, video.videoTexture, nullptr, &screenRect);
         } else {
-            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-            SDL_RenderFillRect(renderer, nullptr);
+            batchFillRect(frameBatch, screenRect, cBlack);
         }
         
         renderText("GAMEOVER", 180, 100, cMagenta);
         renderText("Click to Return To Main Menu", 100, 400, cMagenta);
     }
     
-    
+    endRenderBatch(frameBatch);
     SDL_RenderPresent(renderer);
 }
 
 void renderText(const char* message, int x, int y, SDL_Color color) {
+    // Any size comes from the same field without rasterizing again
+    if (sdfFontLoaded) {
+        if (!drawSdfText(sdfFont, frameBatch, message, static_cast<float>(x), static_cast<float>(y),
+                         TextPixelSize, color)) {
+            SDL_Log("Text rendering failed!");
+        }
+        return;
+    }
     if (!font) {
         SDL_Log("Cannot load font!");
         return;
     }
-    size_t messageLength = strlen(message);
-    SDL_Surface* textSurface = TTF_RenderText_Solid(font, message, messageLength, color);
-    SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-    int textW = textSurface->w; 
-    int textH = textSurface->h;
-    SDL_DestroySurface(textSurface);
-    if (!textTexture) {
-        SDL_Log("Texture creation failed!");
-        return;
+    // Glyphs are rasterized once into the font's atlas, after that a string
+    // is a few quads with no rasterizing or uploading
+    GlyphAtlas* atlas = getGlyphAtlas(renderer, font);
+    if (!drawAtlasText(atlas, frameBatch, message, static_cast<float>(x), static_cast<float>(y), color)) {
+        SDL_Log("Text rendering failed!");
     }
-    SDL_FRect destRect = { static_cast<float>(x), static_cast<float>(y), static_cast<float>(textW), static_cast<float>(textH) };
-    SDL_RenderTexture(renderer, textTexture, nullptr, &destRect);
-    SDL_DestroyTexture(textTexture);
 }
 
-SDL_Texture* getNextFrame(VideoState &video, SDL_Renderer* renderer) {
-    if (!video.pFormatCtx || !video.pCodecCtx) return nullptr;
-    AVPacket packet;
-    AVFrame *frame = av_frame_alloc();
-    while (av_read_frame(video.pFormatCtx, &packet) >= 0) {
-        if (packet.stream_index == video.videoStream) {
-            avcodec_send_packet(video.pCodecCtx, &packet);
-            if (avcodec_receive_frame(video.pCodecCtx, frame) == 0) {
-                if (!video.swsCtx) {
-                    video.swsCtx = sws_getContext(
-                        video.pCodecCtx->width, video.pCodecCtx->height,
-                        video.pCodecCtx->pix_fmt,
-                        video.pCodecCtx->width, video.pCodecCtx->height,
-                        AV_PIX_FMT_RGB24,
-                        SWS_BILINEAR, nullptr, nullptr, nullptr
-                    );
-                    if (!video.swsCtx) {
-                        std::cerr << "Failed to create SwsContext\n";
-                        av_frame_free(&frame);
-                        av_packet_unref(&packet);
-                        return nullptr;
-                    }
-                }
-                if (!video.pFrameRGB) {
-                    video.pFrameRGB = av_frame_alloc();
-                    int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGB24, video.pCodecCtx->width,
-                                                              video.pCodecCtx->height, 1);
-                    if (numBytes < 0) {
-                        std::cerr << "Failed to calculate buffer size\n";
-                        av_frame_free(&frame);
-                        av_packet_unref(&packet);
-                        return nullptr;
-                    }
-                    video.buffer = (uint8_t*) av_malloc(numBytes * sizeof(uint8_t));
-                    if (!video.buffer) {
-                        std::cerr << "Failed to allocate buffer\n";
-                        av_frame_free(&frame);
-                        av_packet_unref(&packet);
-                        return nullptr;
-                    }
-                    av_image_fill_arrays(video.pFrameRGB->data, video.pFrameRGB->linesize,
-                                         video.buffer, AV_PIX_FMT_RGB24,
-                                         video.pCodecCtx->width, video.pCodecCtx->height, 1);
-                }
-                int ret = sws_scale(
-                    video.swsCtx, frame->data, frame->linesize,
-                    0, video.pCodecCtx->height,
-                    video.pFrameRGB->data, video.pFrameRGB->linesize
-                );
-                if (ret < 0) {
-                    std::cerr << "sws_scale failed\n";
-                    av_frame_free(&frame);
-                    av_packet_unref(&packet);
-                    return nullptr;
-                }
-                SDL_Surface* surface = SDL_CreateSurface(video.pCodecCtx->width, video.pCodecCtx->height, SDL_PIXELFORMAT_RGB24);
-                if (!surface) {
-                    std::cerr << "Failed to create SDL surface: " << SDL_GetError() << std::endl;
-                    av_frame_free(&frame);
-                    av_packet_unref(&packet);
-                    return nullptr;
-                }
-                uint8_t* srcData = video.pFrameRGB->data[0];
-                int srcPitch = video.pFrameRGB->linesize[0];
-                uint8_t* dstData = (uint8_t*)surface->pixels;
-                int dstPitch = surface->pitch;
-                int height = video.pCodecCtx->height;
-                int width = std::min(srcPitch, dstPitch);
-                for (int y = 0; y < height; y++) {
-                    memcpy(dstData + y * dstPitch, srcData + y * srcPitch, width);
-                }
-                // Convert Surface to Texture
-                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-                SDL_DestroySurface(surface);
-                av_frame_free(&frame);
-                av_packet_unref(&packet);
-                return texture;
-            }
-        }
-        av_packet_unref(&packet);
+// While the video plays, render every vsync (or at the target rate) so
+// frames are presented at an even pace, and never later than the next
+// video frame is due. Other scenes only render on input.
+void scheduleVideoFrame() {
+    bool playing = currentScene == SceneState::END_SCREEN && videoInitialized;
+    setFrameAnimating(frameScheduler, playing);
+    if (!playing) {
+        return;
     }
-    av_frame_free(&frame);
-    return nullptr;
+    double delay = video.frameDuration;
+    double pts = 0.0;
+    if (getNextVideoFrameTime(video, pts)) {
+        delay = std::max(0.0, pts - getPlaybackClock(video.clock));
+    }
+    scheduleFrameAt(frameScheduler, SDL_GetTicksNS() + static_cast<Uint64>(delay * SDL_NS_PER_SECOND));
+}
+
+// Logged each time the end screen is left and once more at exit
+void logPerformanceStats() {
+    logVideoPlaybackStats(video);
+    logVideoCacheStats();
+    logAudioEngineStats();
+    logGlyphAtlasStats();
+    logSdfFontStats(sdfFont);
+    logRenderBatchStats(frameBatch);
+    logFrameSchedulerStats(frameScheduler);
+    logRenderLayerStats();
 }
 
 void handleEvents(bool& done) {
@@ -420,23 +403,39 @@ void handleEvents(bool& done) {
         if (event.type == SDL_EVENT_QUIT) {
             done = true;
         }
+        else if (event.type == SDL_EVENT_WINDOW_RESIZED ||
+                 event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED) {
+            // Layers are drawn at the old size, redraw them
+            markAllRenderLayersDirty();
+            markFrameDirty(frameScheduler);
+        }
+        else if (event.type >= SDL_EVENT_WINDOW_FIRST && event.type <= SDL_EVENT_WINDOW_LAST) {
+            // Exposed, moved, focus changes: the layers are still good, the
+            // window just needs presenting again
+            markFrameDirty(frameScheduler);
+        }
+        else if (event.type == SDL_EVENT_RENDER_TARGETS_RESET) {
+            // Target texture contents are lost
+            markAllRenderLayersDirty();
+            markFrameDirty(frameScheduler);
+        }
+        else if (event.type == SDL_EVENT_RENDER_DEVICE_RESET) {
+            // The textures themselves are gone, layers recreate them when next drawn
+            destroyRenderLayers();
+            markFrameDirty(frameScheduler);
+        }
         else if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
+            markFrameDirty(frameScheduler);
             int x = event.button.x;
             int y = event.button.y;
 
             if (currentScene == SceneState::MAIN_MENU) {
                 // Transition from MAIN_MENU to GAME
-                cleanupAudio();
-                audioInitialized = false;
-                videoInitialized = false;
                 currentScene = SceneState::GAME;
             }
             else if (currentScene == SceneState::GAME) {
                 // If user clicks in the top-left corner, switch to END_SCREEN
                 if (x < 50 && y < 50) {
-                    cleanupAudio();
-                    audioInitialized = false;
-                    videoInitialized = false;
                     currentScene = SceneState::END_SCREEN;
                     return;
                 }
@@ -445,7 +444,10 @@ void handleEvents(bool& done) {
                 if (boardX >= 0 && boardX < 3 && boardY >= 0 && boardY < 3) {
                     if (board[boardY][boardX] == Player::NONE) {
                         board[boardY][boardX] = Player1;
-                        newPlacementMade = true;
+                        markRenderLayerDirty(boardLayer);
+                        // Played straight from the click, panned toward its column.
+                        // The event timestamp is what latency is measured from.
+                        playSoundEffect(blipSound, 1.0f, (boardX - 1) * 0.5f, event.button.timestamp);
                         if (checkWin(Player1)) {
                             std::string winnerName = (Player1 == Player::X) ? "Player 1" : "Player 2";
                             SDL_Log("%s wins!", winnerName.c_str());
@@ -463,7 +465,10 @@ void handleEvents(bool& done) {
                             }
                             std::cout << "Current scores in the database:" << std::endl;
                             dbManager.queryScores();
-                            if (player1WinCount >= 3 || player2WinCount >= 3) {
+                            if (player1WinCount >= WinsToPrefetch || player2WinCount >= WinsToPrefetch) {
+                                prefetchEndScreen();
+                            }
+                            if (player1WinCount >= WinsToEndScreen || player2WinCount >= WinsToEndScreen) {
                                 currentScene = SceneState::END_SCREEN;
                                 return;
                             }
@@ -477,30 +482,9 @@ void handleEvents(bool& done) {
                 // Reset for returning to MAIN_MENU
                 player1WinCount = 0;
                 player2WinCount = 0;
-                cleanupAudio();
-                if (video.pFrameRGB) {
-                    av_frame_free(&video.pFrameRGB);
-                    video.pFrameRGB = nullptr;
-                }
-                if (video.buffer) {
-                    av_free(video.buffer);
-                    video.buffer = nullptr;
-                }
-                if (video.swsCtx) {
-                    sws_freeContext(video.swsCtx);
-                    video.swsCtx = nullptr;
-                }
-                if (video.pAudioCodecCtx) {
-                    avcodec_free_context(&video.pAudioCodecCtx);
-                }
-                if (video.pCodecCtx) {
-                    avcodec_free_context(&video.pCodecCtx);
-                }
-                if (video.pFormatCtx) {
-                    avformat_close_input(&video.pFormatCtx);
-                }
-                videoInitialized = false;
-                audioInitialized = false;
+                // Keep the player open so coming back doesn't reopen the file
+                pauseVideo(video);
+                logPerformanceStats();
                 currentScene = SceneState::MAIN_MENU;
             }
         }
@@ -523,10 +507,14 @@ void resetBoard() {
         row.fill(Player::NONE);
     }
     Player1 = Player::X;
+    markRenderLayerDirty(boardLayer);
 }
 
 void close() {
-    cleanupAudio();
+    shutdownAudioEngine();
+    destroyRenderLayers();
+    destroyGlyphAtlases();
+    closeSdfFont(sdfFont);
     if (font) {
         TTF_CloseFont(font);
         font = nullptr;
@@ -0,0 +1,117 @@
+#include "mediaIO.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C"
+{
+    #include <libavutil/mem.h>
+    #include <libavutil/error.h>
+}
+
+//libavformat's probe/header buffer. Reads bigger than this (most packet
+//payloads) bypass it and land directly in the packet.
+constexpr int MediaIOBufferSize = 32 * 1024;
+
+static int readMappedMedia(void *opaque, uint8_t *buffer, int bufferSize)
+{
+    MappedMedia &media = *static_cast<MappedMedia*>(opaque);
+    if (media.position >= media.size) return AVERROR_EOF;
+
+    Uint64 remaining = media.size - media.position;
+    int bytes = (remaining < static_cast<Uint64>(bufferSize)) ? static_cast<int>(remaining) : bufferSize;
+    std::memcpy(buffer, media.data + media.position, bytes);
+    media.position += bytes;
+    return bytes;
+}
+
+static int64_t seekMappedMedia(void *opaque, int64_t offset, int whence)
+{
+    MappedMedia &media = *static_cast<MappedMedia*>(opaque);
+    int64_t size = static_cast<int64_t>(media.size);
+
+    int64_t target;
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE: return size;
+        case SEEK_SET: target = offset; break;
+        case SEEK_CUR: target = static_cast<int64_t>(media.position) + offset; break;
+        case SEEK_END: target = size + offset; break;
+        default: return AVERROR(EINVAL);
+    }
+    if (target < 0 || target > size) return AVERROR(EINVAL);
+    media.position = static_cast<Uint64>(target);
+    return target;
+}
+
+bool openMappedMedia(MappedMedia &media, const std::string &path, Uint64 offset, Uint64 length)
+{
+    closeMappedMedia(media);
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        SDL_Log("Failed to open %s for mapping", path.c_str());
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<Uint64>(info.st_size) <= offset) {
+        SDL_Log("Media range %llu+ is outside %s", static_cast<unsigned long long>(offset), path.c_str());
+        close(fd);
+        return false;
+    }
+    Uint64 available = static_cast<Uint64>(info.st_size) - offset;
+    if (length == 0 || length > available) length = available;
+
+    //mmap offsets have to be page aligned, slices usually aren't
+    Uint64 pageSize = static_cast<Uint64>(sysconf(_SC_PAGESIZE));
+    Uint64 mapOffset = offset - offset % pageSize;
+    size_t mapBytes = static_cast<size_t>(offset - mapOffset + length);
+    void *mapping = mmap(nullptr, mapBytes, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(mapOffset));
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        SDL_Log("Failed to map %s", path.c_str());
+        return false;
+    }
+    //Looping clips are read front to back over and over, keep them resident
+    madvise(mapping, mapBytes, MADV_WILLNEED);
+
+    media.mapping = mapping;
+    media.mappingBytes = mapBytes;
+    media.data = static_cast<const Uint8*>(mapping) + (offset - mapOffset);
+    media.size = length;
+    media.position = 0;
+
+    Uint8 *buffer = static_cast<Uint8*>(av_malloc(MediaIOBufferSize));
+    if (buffer) {
+        media.avio = avio_alloc_context(buffer, MediaIOBufferSize, 0, &media,
+                                        readMappedMedia, nullptr, seekMappedMedia);
+    }
+    if (!media.avio) {
+        SDL_Log("Failed to create AVIOContext for %s", path.c_str());
+        av_free(buffer);
+        closeMappedMedia(media);
+        return false;
+    }
+    media.avio->seekable = AVIO_SEEKABLE_NORMAL;
+    return true;
+}
+
+void closeMappedMedia(MappedMedia &media)
+{
+    if (media.avio) {
+        //The context may have swapped its buffer, free the one it holds now
+        av_freep(&media.avio->buffer);
+        avio_context_free(&media.avio);
+    }
+    if (media.mapping) {
+        munmap(media.mapping, media.mappingBytes);
+        media.mapping = nullptr;
+    }
+    media.mappingBytes = 0;
+    media.data = nullptr;
+    media.size = 0;
+    media.position = 0;
+}
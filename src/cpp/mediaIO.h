@@ -0,0 +1,30 @@
+#ifndef MEDIA_IO_H
+#define MEDIA_IO_H
+
+#include <string>
+#include <SDL3/SDL.h>
+
+extern "C"
+{
+    #include <libavformat/avio.h>
+}
+
+//A media file, or a byte range of a packed asset file, mapped read-only and
+//served to libavformat through a custom AVIOContext. Reads come straight
+//from the page cache with no read() syscalls, and seeks are pointer moves.
+struct MappedMedia
+{
+    void *mapping = nullptr;        //page-aligned start of the mapping
+    size_t mappingBytes = 0;
+    const Uint8 *data = nullptr;    //first byte of the media itself
+    Uint64 size = 0;
+    Uint64 position = 0;
+    AVIOContext *avio = nullptr;
+};
+
+//length 0 maps everything from offset to the end of the file
+bool openMappedMedia(MappedMedia &media, const std::string &path, Uint64 offset = 0, Uint64 length = 0);
+//Only after the AVFormatContext using media.avio has been closed
+void closeMappedMedia(MappedMedia &media);
+
+#endif
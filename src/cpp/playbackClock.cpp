@@ -0,0 +1,73 @@
+#include "playbackClock.h"
+
+#include <cmath>
+
+//Beyond this the clock snaps to audio instead of slewing toward it
+constexpr double ClockSnapThreshold = 0.100;
+//Fraction of the remaining drift corrected per sync
+constexpr double ClockSlewFactor = 0.1;
+
+void resetPlaybackClock(PlaybackClock &clock, double mediaTime)
+{
+    clock.anchorTicksNS = SDL_GetTicksNS();
+    clock.anchorTime = mediaTime;
+}
+
+double getPlaybackClock(const PlaybackClock &clock)
+{
+    if (clock.paused) return clock.anchorTime;
+    Uint64 elapsedNS = SDL_GetTicksNS() - clock.anchorTicksNS;
+    return clock.anchorTime + static_cast<double>(elapsedNS) / SDL_NS_PER_SECOND;
+}
+
+void pausePlaybackClock(PlaybackClock &clock)
+{
+    if (clock.paused) return;
+    clock.anchorTime = getPlaybackClock(clock);
+    clock.paused = true;
+}
+
+void resumePlaybackClock(PlaybackClock &clock)
+{
+    if (!clock.paused) return;
+    clock.paused = false;
+    clock.anchorTicksNS = SDL_GetTicksNS();
+}
+
+void syncPlaybackClock(PlaybackClock &clock, double audioTime)
+{
+    if (clock.paused) return;
+    double current = getPlaybackClock(clock);
+    double drift = audioTime - current;
+    if (std::fabs(drift) > ClockSnapThreshold) {
+        resetPlaybackClock(clock, audioTime);
+    } else {
+        resetPlaybackClock(clock, current + drift * ClockSlewFactor);
+    }
+}
+
+bool getAudioStreamClock(SDL_AudioStream *stream, SDL_AudioDeviceID device,
+                         const SDL_AudioSpec &spec, Uint64 totalBytes, double &audioTime)
+{
+    if (!stream || !device || spec.freq <= 0) return false;
+
+    //A drained stream has stopped advancing and can no longer be the master
+    int queued = SDL_GetAudioStreamQueued(stream);
+    if (queued <= 0) return false;
+
+    int frameSize = SDL_AUDIO_FRAMESIZE(spec);
+    if (frameSize <= 0) return false;
+    double consumedFrames = static_cast<double>(totalBytes - static_cast<Uint64>(queued)) / frameSize;
+
+    //Samples pulled from the stream still sit in the device buffer for a while
+    SDL_AudioSpec deviceSpec;
+    int deviceFrames = 0;
+    double deviceLatency = 0.0;
+    if (SDL_GetAudioDeviceFormat(device, &deviceSpec, &deviceFrames) && deviceSpec.freq > 0) {
+        deviceLatency = static_cast<double>(deviceFrames) / deviceSpec.freq;
+    }
+
+    audioTime = consumedFrames / spec.freq - deviceLatency;
+    if (audioTime < 0.0) audioTime = 0.0;
+    return true;
+}
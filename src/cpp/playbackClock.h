@@ -0,0 +1,33 @@
+#ifndef PLAYBACK_CLOCK_H
+#define PLAYBACK_CLOCK_H
+
+#include <SDL3/SDL.h>
+
+//Media time in seconds, driven by SDL_GetTicksNS() between corrections from
+//the audio device. Video frames are scheduled against this clock.
+struct PlaybackClock
+{
+    Uint64 anchorTicksNS = 0;
+    double anchorTime = 0.0;
+    bool paused = false;
+};
+
+void resetPlaybackClock(PlaybackClock &clock, double mediaTime = 0.0);
+double getPlaybackClock(const PlaybackClock &clock);
+
+//A paused clock holds its current media time until resumed
+void pausePlaybackClock(PlaybackClock &clock);
+void resumePlaybackClock(PlaybackClock &clock);
+
+//Pulls the clock toward the audio position. Small drift is slewed out so the
+//picture doesn't judder with the device's buffer granularity, larger jumps
+//(a hitch, a device stall) snap immediately.
+void syncPlaybackClock(PlaybackClock &clock, double audioTime);
+
+//Seconds of audio the device has actually played from a stream that was fed
+//totalBytes of data in the given format. Returns false if nothing is bound
+//or the stream has drained.
+bool getAudioStreamClock(SDL_AudioStream *stream, SDL_AudioDeviceID device,
+                         const SDL_AudioSpec &spec, Uint64 totalBytes, double &audioTime);
+
+#endif
@@ -0,0 +1,173 @@
+#include "renderBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+static SDL_FColor toFColor(SDL_Color color)
+{
+    return {color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f};
+}
+
+static RenderBatchBucket& findBucket(RenderBatch &batch, SDL_Texture *texture)
+{
+    for (int i = 0; i < batch.activeBuckets; ++i) {
+        if (batch.buckets[i].texture == texture) return batch.buckets[i];
+    }
+    if (batch.activeBuckets == static_cast<int>(batch.buckets.size())) {
+        batch.buckets.emplace_back();
+    }
+    RenderBatchBucket &bucket = batch.buckets[batch.activeBuckets++];
+    bucket.texture = texture;
+    bucket.texelWidth = 1.0f;
+    bucket.texelHeight = 1.0f;
+    float width = 0.0f, height = 0.0f;
+    if (texture && SDL_GetTextureSize(texture, &width, &height) && width > 0.0f && height > 0.0f) {
+        bucket.texelWidth = 1.0f / width;
+        bucket.texelHeight = 1.0f / height;
+    }
+    return bucket;
+}
+
+//Corners in order top-left, top-right, bottom-right, bottom-left
+static void addQuad(RenderBatch &batch, RenderBatchBucket &bucket, const SDL_FPoint corners[4],
+                    const SDL_FPoint uv[4], SDL_FColor color)
+{
+    int base = static_cast<int>(bucket.vertices.size());
+    for (int i = 0; i < 4; ++i) {
+        bucket.vertices.push_back({corners[i], color, uv[i]});
+    }
+    const int order[6] = {0, 1, 2, 0, 2, 3};
+    for (int i : order) {
+        bucket.indices.push_back(base + i);
+    }
+    ++batch.stats.quads;
+}
+
+static void addRect(RenderBatch &batch, RenderBatchBucket &bucket, const SDL_FRect &rect,
+                    const SDL_FPoint uv[4], SDL_FColor color)
+{
+    const SDL_FPoint corners[4] = {
+        {rect.x, rect.y},
+        {rect.x + rect.w, rect.y},
+        {rect.x + rect.w, rect.y + rect.h},
+        {rect.x, rect.y + rect.h}
+    };
+    addQuad(batch, bucket, corners, uv, color);
+}
+
+static const SDL_FPoint NoUV[4] = {{0.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 0.0f}, {0.0f, 0.0f}};
+
+void beginRenderBatch(RenderBatch &batch, SDL_Renderer *renderer)
+{
+    //Drops anything left over from a frame that was abandoned before its end
+    for (int i = 0; i < batch.activeBuckets; ++i) {
+        batch.buckets[i].vertices.clear();
+        batch.buckets[i].indices.clear();
+    }
+    batch.renderer = renderer;
+    batch.activeBuckets = 0;
+    batch.frameDrawCalls = 0;
+}
+
+void flushRenderBatch(RenderBatch &batch)
+{
+    for (int i = 0; i < batch.activeBuckets; ++i) {
+        RenderBatchBucket &bucket = batch.buckets[i];
+        if (!bucket.indices.empty()) {
+            if (!SDL_RenderGeometry(batch.renderer, bucket.texture,
+                                    bucket.vertices.data(), static_cast<int>(bucket.vertices.size()),
+                                    bucket.indices.data(), static_cast<int>(bucket.indices.size()))) {
+                SDL_Log("Batched draw failed: %s", SDL_GetError());
+            }
+            ++batch.frameDrawCalls;
+        }
+        bucket.vertices.clear();
+        bucket.indices.clear();
+        bucket.texture = nullptr;
+    }
+    batch.activeBuckets = 0;
+}
+
+void endRenderBatch(RenderBatch &batch)
+{
+    flushRenderBatch(batch);
+    ++batch.stats.frames;
+    batch.stats.drawCalls += batch.frameDrawCalls;
+    batch.stats.lastFrameDrawCalls = batch.frameDrawCalls;
+    batch.stats.maxFrameDrawCalls = std::max(batch.stats.maxFrameDrawCalls, batch.frameDrawCalls);
+}
+
+void batchFillRect(RenderBatch &batch, const SDL_FRect &rect, SDL_Color color)
+{
+    addRect(batch, findBucket(batch, nullptr), rect, NoUV, toFColor(color));
+}
+
+void batchRect(RenderBatch &batch, const SDL_FRect &rect, SDL_Color color)
+{
+    RenderBatchBucket &bucket = findBucket(batch, nullptr);
+    SDL_FColor fcolor = toFColor(color);
+    addRect(batch, bucket, {rect.x, rect.y, rect.w, 1.0f}, NoUV, fcolor);
+    addRect(batch, bucket, {rect.x, rect.y + rect.h - 1.0f, rect.w, 1.0f}, NoUV, fcolor);
+    addRect(batch, bucket, {rect.x, rect.y + 1.0f, 1.0f, rect.h - 2.0f}, NoUV, fcolor);
+    addRect(batch, bucket, {rect.x + rect.w - 1.0f, rect.y + 1.0f, 1.0f, rect.h - 2.0f}, NoUV, fcolor);
+}
+
+void batchLine(RenderBatch &batch, float x1, float y1, float x2, float y2, SDL_Color color)
+{
+    //A quad half a pixel either side of the line, through the pixel centres
+    float dx = x2 - x1;
+    float dy = y2 - y1;
+    float length = std::sqrt(dx * dx + dy * dy);
+    if (length <= 0.0f) {
+        batchFillRect(batch, {x1, y1, 1.0f, 1.0f}, color);
+        return;
+    }
+    float nx = -dy / length * 0.5f;
+    float ny = dx / length * 0.5f;
+    x1 += 0.5f;
+    y1 += 0.5f;
+    x2 += 0.5f;
+    y2 += 0.5f;
+    const SDL_FPoint corners[4] = {
+        {x1 + nx, y1 + ny},
+        {x2 + nx, y2 + ny},
+        {x2 - nx, y2 - ny},
+        {x1 - nx, y1 - ny}
+    };
+    addQuad(batch, findBucket(batch, nullptr), corners, NoUV, toFColor(color));
+}
+
+void batchTexture(RenderBatch &batch, SDL_Texture *texture, const SDL_FRect *src,
+                  const SDL_FRect *dst, SDL_Color tint)
+{
+    if (!texture) return;
+    RenderBatchBucket &bucket = findBucket(batch, texture);
+
+    float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+    if (src) {
+        u0 = src->x * bucket.texelWidth;
+        v0 = src->y * bucket.texelHeight;
+        u1 = (src->x + src->w) * bucket.texelWidth;
+        v1 = (src->y + src->h) * bucket.texelHeight;
+    }
+    SDL_FRect target;
+    if (dst) {
+        target = *dst;
+    } else {
+        int width = 0, height = 0;
+        SDL_GetCurrentRenderOutputSize(batch.renderer, &width, &height);
+        target = {0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)};
+    }
+    const SDL_FPoint uv[4] = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+    addRect(batch, bucket, target, uv, toFColor(tint));
+}
+
+void logRenderBatchStats(const RenderBatch &batch)
+{
+    const RenderBatchStats &stats = batch.stats;
+    double average = stats.frames ? static_cast<double>(stats.drawCalls) / stats.frames : 0.0;
+    SDL_Log("Render batch: %llu frames, %.2f draw calls per frame (last %d, max %d), %llu quads",
+            static_cast<unsigned long long>(stats.frames), average,
+            stats.lastFrameDrawCalls, stats.maxFrameDrawCalls,
+            static_cast<unsigned long long>(stats.quads));
+}
@@ -0,0 +1,60 @@
+#ifndef RENDER_BATCH_H
+#define RENDER_BATCH_H
+
+#include <vector>
+#include <SDL3/SDL.h>
+
+//Everything drawn with one texture (or none, for lines and rects) in a
+//frame, as a single triangle list
+struct RenderBatchBucket
+{
+    SDL_Texture *texture = nullptr;
+    float texelWidth = 1.0f;    //1 / texture width, to normalize source rects
+    float texelHeight = 1.0f;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+};
+
+struct RenderBatchStats
+{
+    Uint64 frames = 0;
+    Uint64 drawCalls = 0;
+    Uint64 quads = 0;
+    int lastFrameDrawCalls = 0;
+    int maxFrameDrawCalls = 0;
+};
+
+//Collects a frame's 2D drawing and submits it with one SDL_RenderGeometry
+//call per texture. Buckets are drawn in the order their texture was first
+//used since the last flush, so anything that has to cover something drawn
+//with a later texture needs a flushRenderBatch() in between. Bucket storage
+//is kept between frames, so a steady frame doesn't allocate.
+struct RenderBatch
+{
+    SDL_Renderer *renderer = nullptr;
+    std::vector<RenderBatchBucket> buckets;
+    int activeBuckets = 0;
+    int frameDrawCalls = 0;
+    RenderBatchStats stats;
+};
+
+void beginRenderBatch(RenderBatch &batch, SDL_Renderer *renderer);
+//Submits what has been collected so far, for ordering or before a direct
+//SDL_Render* call
+void flushRenderBatch(RenderBatch &batch);
+//Flushes and closes the frame's draw-call count
+void endRenderBatch(RenderBatch &batch);
+
+void batchFillRect(RenderBatch &batch, const SDL_FRect &rect, SDL_Color color);
+//One pixel outline, like SDL_RenderRect
+void batchRect(RenderBatch &batch, const SDL_FRect &rect, SDL_Color color);
+//One pixel wide, like SDL_RenderLine
+void batchLine(RenderBatch &batch, float x1, float y1, float x2, float y2, SDL_Color color);
+//src in texels, nullptr for the whole texture; dst nullptr for the whole target.
+//tint multiplies the texture like a color mod would.
+void batchTexture(RenderBatch &batch, SDL_Texture *texture, const SDL_FRect *src,
+                  const SDL_FRect *dst, SDL_Color tint = {255, 255, 255, 255});
+
+void logRenderBatchStats(const RenderBatch &batch);
+
+#endif
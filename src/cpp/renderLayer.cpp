@@ -0,0 +1,98 @@
+#include "renderLayer.h"
+
+#include <vector>
+
+//Every layer that has been drawn, so they can be invalidated and released together
+static std::vector<RenderLayer*> renderLayers;
+
+static void releaseLayerTexture(RenderLayer &layer)
+{
+    if (layer.texture) {
+        SDL_DestroyTexture(layer.texture);
+        layer.texture = nullptr;
+    }
+    layer.width = 0;
+    layer.height = 0;
+    layer.dirty = true;
+}
+
+bool beginRenderLayer(RenderLayer &layer, RenderBatch &batch, int width, int height)
+{
+    if (layer.texture && !layer.dirty && layer.width == width && layer.height == height) return false;
+    if (!layer.registered) {
+        renderLayers.push_back(&layer);
+        layer.registered = true;
+    }
+
+    if (layer.direct) return true;
+    if (!layer.texture || layer.width != width || layer.height != height) {
+        releaseLayerTexture(layer);
+        layer.texture = SDL_CreateTexture(batch.renderer, SDL_PIXELFORMAT_RGBA32,
+                                          SDL_TEXTUREACCESS_TARGET, width, height);
+        if (!layer.texture) {
+            SDL_Log("Failed to create %s layer, drawing it directly: %s", layer.name, SDL_GetError());
+            layer.direct = true;
+            return true;
+        }
+        //Drawing blended content over a transparent target leaves it premultiplied
+        SDL_SetTextureBlendMode(layer.texture, SDL_BLENDMODE_BLEND_PREMULTIPLIED);
+        layer.width = width;
+        layer.height = height;
+    }
+
+    flushRenderBatch(batch);
+    layer.previousTarget = SDL_GetRenderTarget(batch.renderer);
+    SDL_SetRenderTarget(batch.renderer, layer.texture);
+    SDL_SetRenderDrawColor(batch.renderer, 0, 0, 0, 0);
+    SDL_RenderClear(batch.renderer);
+    return true;
+}
+
+void endRenderLayer(RenderLayer &layer, RenderBatch &batch)
+{
+    if (!layer.texture) return;
+    flushRenderBatch(batch);
+    SDL_SetRenderTarget(batch.renderer, layer.previousTarget);
+    layer.previousTarget = nullptr;
+    layer.dirty = false;
+    ++layer.redraws;
+}
+
+void compositeRenderLayer(RenderLayer &layer, RenderBatch &batch, const SDL_FRect &dst)
+{
+    if (!layer.texture) return;
+    batchTexture(batch, layer.texture, nullptr, &dst);
+    ++layer.composites;
+}
+
+void markRenderLayerDirty(RenderLayer &layer)
+{
+    layer.dirty = true;
+}
+
+void markAllRenderLayersDirty()
+{
+    for (RenderLayer *layer : renderLayers) {
+        layer->dirty = true;
+    }
+}
+
+void destroyRenderLayers()
+{
+    for (RenderLayer *layer : renderLayers) {
+        releaseLayerTexture(*layer);
+        layer->registered = false;
+        layer->direct = false;
+    }
+    renderLayers.clear();
+}
+
+void logRenderLayerStats()
+{
+    for (const RenderLayer *layer : renderLayers) {
+        SDL_Log("Render layer %s: %dx%d, %llu redraws for %llu composites", layer->name,
+                layer->width, layer->height,
+                static_cast<unsigned long long>(layer->redraws),
+                static_cast<unsigned long long>(layer->composites));
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef RENDER_LAYER_H
+#define RENDER_LAYER_H
+
+#include <SDL3/SDL.h>
+
+#include "renderBatch.h"
+
+//Content that rarely changes, drawn once into a target texture and
+//composited as a single quad every frame until it is marked dirty.
+struct RenderLayer
+{
+    const char *name = "layer";
+    SDL_Texture *texture = nullptr;
+    SDL_Texture *previousTarget = nullptr;
+    int width = 0;
+    int height = 0;
+    bool dirty = true;
+    bool registered = false;
+    bool direct = false;        //no target texture could be made
+    Uint64 redraws = 0;
+    Uint64 composites = 0;
+};
+
+//Returns true when the layer's content has to be drawn: the first time, after
+//markRenderLayerDirty(), or when the size changed. The batch is flushed and
+//rendering redirected into the layer until endRenderLayer(). If no target
+//texture can be made, it returns true every frame and the content goes
+//straight to the screen instead.
+bool beginRenderLayer(RenderLayer &layer, RenderBatch &batch, int width, int height);
+void endRenderLayer(RenderLayer &layer, RenderBatch &batch);
+void compositeRenderLayer(RenderLayer &layer, RenderBatch &batch, const SDL_FRect &dst);
+
+void markRenderLayerDirty(RenderLayer &layer);
+//For window resizes and lost render targets, which affect every layer
+void markAllRenderLayersDirty();
+//Must run before the renderer is destroyed
+void destroyRenderLayers();
+void logRenderLayerStats();
+
+#endif
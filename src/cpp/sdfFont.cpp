@@ -0,0 +1,431 @@
+#include "sdfFont.h"
+
+#include <SDL3_ttf/SDL_ttf.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+constexpr Uint32 SdfCacheMagic = 0x46445341;   //"ASDF"
+constexpr Uint32 SdfCacheVersion = 2;
+constexpr Uint32 SdfGlyphCount = SdfLastCodepoint - SdfFirstCodepoint + 1;
+
+static Uint32 kerningKey(Uint32 first, Uint32 second)
+{
+    return (first << 16) | second;
+}
+
+//A same-sized edit of the TTF must still invalidate the cache, so the
+//contents are hashed; fonts are small enough to do it on every start
+static bool fingerprintFile(const std::string &path, Uint64 &bytes, Uint64 &hash)
+{
+    size_t size = 0;
+    Uint8 *data = static_cast<Uint8*>(SDL_LoadFile(path.c_str(), &size));
+    if (!data) return false;
+    hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    bytes = size;
+    SDL_free(data);
+    return true;
+}
+
+//Distance from each field texel to the nearest texel on the other side of
+//the glyph's edge, searched within the spread. Coverage is read from the
+//alpha of an RGBA32 cell, starting at (left, top).
+static void buildGlyphField(SdfFont &font, const SdfGlyph &glyph, const SDL_Surface *cell,
+                            int left, int top)
+{
+    const Uint8 *pixels = static_cast<const Uint8*>(cell->pixels);
+    auto inside = [&](int x, int y) {
+        if (x < 0 || y < 0 || x >= cell->w || y >= cell->h) return false;
+        return pixels[y * cell->pitch + x * 4 + 3] >= 128;
+    };
+
+    for (int fy = 0; fy < glyph.field.h; ++fy) {
+        for (int fx = 0; fx < glyph.field.w; ++fx) {
+            int cx = left + fx - SdfSpread;
+            int cy = top + fy - SdfSpread;
+            bool in = inside(cx, cy);
+            int nearest = SdfSpread * SdfSpread * 2 + 1;
+            for (int dy = -SdfSpread; dy <= SdfSpread; ++dy) {
+                for (int dx = -SdfSpread; dx <= SdfSpread; ++dx) {
+                    int distance = dx * dx + dy * dy;
+                    if (distance < nearest && inside(cx + dx, cy + dy) != in) nearest = distance;
+                }
+            }
+            //Edges sit half way between the two texels that straddle them
+            float distance = std::min(std::sqrt(static_cast<float>(nearest)) - 0.5f,
+                                      static_cast<float>(SdfSpread));
+            float value = 0.5f + (in ? distance : -distance) / (2.0f * SdfSpread);
+            size_t index = static_cast<size_t>(glyph.field.y + fy) * font.fieldWidth + glyph.field.x + fx;
+            font.field[index] = static_cast<Uint8>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+bool bakeSdfFont(SdfFont &font, const std::string &ttfPath)
+{
+    TTF_Font *ttf = TTF_OpenFont(ttfPath.c_str(), static_cast<float>(SdfBaseSize));
+    if (!ttf) {
+        SDL_Log("Cannot bake SDF font, failed to open %s: %s", ttfPath.c_str(), SDL_GetError());
+        return false;
+    }
+
+    font.lineHeight = TTF_GetFontHeight(ttf);
+    font.fieldWidth = SdfFieldWidth;
+    font.fieldHeight = 0;
+    font.field.clear();
+    font.glyphs.assign(SdfGlyphCount, SdfGlyph());
+    font.kerning.clear();
+    font.sourceBytes = 0;
+    font.sourceHash = 0;
+    fingerprintFile(ttfPath, font.sourceBytes, font.sourceHash);
+
+    //Shelf packer, the field grows downwards as rows are added
+    int penX = 0, penY = 0, rowHeight = 0;
+    SDL_Color white = {255, 255, 255, 255};
+    for (Uint32 codepoint = SdfFirstCodepoint; codepoint <= SdfLastCodepoint; ++codepoint) {
+        SdfGlyph &glyph = font.glyphs[codepoint - SdfFirstCodepoint];
+        int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+        if (!TTF_GetGlyphMetrics(ttf, codepoint, &minX, &maxX, &minY, &maxY, &advance)) continue;
+        glyph.advance = advance;
+        if (maxX <= minX) continue;
+
+        SDL_Surface *cell = TTF_RenderGlyph_Blended(ttf, codepoint, white);
+        if (cell && cell->format != SDL_PIXELFORMAT_RGBA32) {
+            SDL_Surface *converted = SDL_ConvertSurface(cell, SDL_PIXELFORMAT_RGBA32);
+            SDL_DestroySurface(cell);
+            cell = converted;
+        }
+        if (!cell) continue;
+
+        //Only the covered part of the cell goes into the field
+        const Uint8 *pixels = static_cast<const Uint8*>(cell->pixels);
+        int left = cell->w, top = cell->h, right = -1, bottom = -1;
+        for (int y = 0; y < cell->h; ++y) {
+            for (int x = 0; x < cell->w; ++x) {
+                if (pixels[y * cell->pitch + x * 4 + 3] == 0) continue;
+                left = std::min(left, x);
+                right = std::max(right, x);
+                top = std::min(top, y);
+                bottom = std::max(bottom, y);
+            }
+        }
+        if (right < 0) {
+            SDL_DestroySurface(cell);
+            continue;
+        }
+
+        int width = right - left + 1 + 2 * SdfSpread;
+        int height = bottom - top + 1 + 2 * SdfSpread;
+        if (penX + width > font.fieldWidth) {
+            penX = 0;
+            penY += rowHeight;
+            rowHeight = 0;
+        }
+        if (penY + height > font.fieldHeight) {
+            font.fieldHeight = penY + height;
+            font.field.resize(static_cast<size_t>(font.fieldWidth) * font.fieldHeight, 0);
+        }
+        glyph.field = {penX, penY, width, height};
+        //TTF shifts a cell right by any overhang to the left of the pen
+        glyph.offsetX = std::min(0, minX) + left - SdfSpread;
+        glyph.offsetY = top - SdfSpread;
+        buildGlyphField(font, glyph, cell, left, top);
+        SDL_DestroySurface(cell);
+        penX += width;
+        rowHeight = std::max(rowHeight, height);
+    }
+
+    for (Uint32 first = SdfFirstCodepoint; first <= SdfLastCodepoint; ++first) {
+        for (Uint32 second = SdfFirstCodepoint; second <= SdfLastCodepoint; ++second) {
+            int amount = 0;
+            if (TTF_GetGlyphKerning(ttf, first, second, &amount) && amount != 0) {
+                font.kerning[kerningKey(first, second)] = amount;
+            }
+        }
+    }
+    TTF_CloseFont(ttf);
+
+    SDL_Log("Baked SDF font from %s: %dx%d field, %zu kerning pairs",
+            ttfPath.c_str(), font.fieldWidth, font.fieldHeight, font.kerning.size());
+    return font.fieldHeight > 0;
+}
+
+bool saveSdfFont(const SdfFont &font, const std::string &cachePath)
+{
+    SDL_IOStream *io = SDL_IOFromFile(cachePath.c_str(), "wb");
+    if (!io) {
+        SDL_Log("Cannot write SDF cache %s: %s", cachePath.c_str(), SDL_GetError());
+        return false;
+    }
+    bool ok = SDL_WriteU32LE(io, SdfCacheMagic) && SDL_WriteU32LE(io, SdfCacheVersion) &&
+              SDL_WriteU32LE(io, SdfBaseSize) && SDL_WriteU32LE(io, SdfSpread) &&
+              SDL_WriteU32LE(io, static_cast<Uint32>(font.sourceBytes)) &&
+              SDL_WriteU32LE(io, static_cast<Uint32>(font.sourceBytes >> 32)) &&
+              SDL_WriteU32LE(io, static_cast<Uint32>(font.sourceHash)) &&
+              SDL_WriteU32LE(io, static_cast<Uint32>(font.sourceHash >> 32)) &&
+              SDL_WriteS32LE(io, font.lineHeight) &&
+              SDL_WriteS32LE(io, font.fieldWidth) && SDL_WriteS32LE(io, font.fieldHeight) &&
+              SDL_WriteU32LE(io, static_cast<Uint32>(font.glyphs.size()));
+    for (const SdfGlyph &glyph : font.glyphs) {
+        ok = ok && SDL_WriteS32LE(io, glyph.field.x) && SDL_WriteS32LE(io, glyph.field.y) &&
+             SDL_WriteS32LE(io, glyph.field.w) && SDL_WriteS32LE(io, glyph.field.h) &&
+             SDL_WriteS32LE(io, glyph.offsetX) && SDL_WriteS32LE(io, glyph.offsetY) &&
+             SDL_WriteS32LE(io, glyph.advance);
+    }
+    ok = ok && SDL_WriteU32LE(io, static_cast<Uint32>(font.kerning.size()));
+    for (const auto &pair : font.kerning) {
+        ok = ok && SDL_WriteU32LE(io, pair.first) && SDL_WriteS32LE(io, pair.second);
+    }
+    ok = ok && SDL_WriteIO(io, font.field.data(), font.field.size()) == font.field.size();
+    SDL_CloseIO(io);
+    if (!ok) SDL_Log("Failed writing SDF cache %s", cachePath.c_str());
+    return ok;
+}
+
+bool readSdfFont(SdfFont &font, const std::string &cachePath)
+{
+    SDL_IOStream *io = SDL_IOFromFile(cachePath.c_str(), "rb");
+    if (!io) return false;
+
+    Uint32 magic = 0, version = 0, baseSize = 0, spread = 0, glyphCount = 0;
+    Uint32 sourceLow = 0, sourceHigh = 0, hashLow = 0, hashHigh = 0;
+    Sint32 lineHeight = 0, fieldWidth = 0, fieldHeight = 0;
+    bool ok = SDL_ReadU32LE(io, &magic) && SDL_ReadU32LE(io, &version) &&
+              SDL_ReadU32LE(io, &baseSize) && SDL_ReadU32LE(io, &spread) &&
+              SDL_ReadU32LE(io, &sourceLow) && SDL_ReadU32LE(io, &sourceHigh) &&
+              SDL_ReadU32LE(io, &hashLow) && SDL_ReadU32LE(io, &hashHigh) &&
+              SDL_ReadS32LE(io, &lineHeight) &&
+              SDL_ReadS32LE(io, &fieldWidth) && SDL_ReadS32LE(io, &fieldHeight) &&
+              SDL_ReadU32LE(io, &glyphCount);
+    //Anything baked with other constants is rebaked rather than converted
+    if (!ok || magic != SdfCacheMagic || version != SdfCacheVersion ||
+        baseSize != SdfBaseSize || spread != SdfSpread || glyphCount != SdfGlyphCount ||
+        fieldWidth <= 0 || fieldHeight <= 0 || fieldWidth * static_cast<Sint64>(fieldHeight) > 64 * 1024 * 1024) {
+        SDL_CloseIO(io);
+        return false;
+    }
+
+    font.sourceBytes = (static_cast<Uint64>(sourceHigh) << 32) | sourceLow;
+    font.sourceHash = (static_cast<Uint64>(hashHigh) << 32) | hashLow;
+    font.lineHeight = lineHeight;
+    font.fieldWidth = fieldWidth;
+    font.fieldHeight = fieldHeight;
+    font.glyphs.assign(glyphCount, SdfGlyph());
+    for (SdfGlyph &glyph : font.glyphs) {
+        ok = ok && SDL_ReadS32LE(io, &glyph.field.x) && SDL_ReadS32LE(io, &glyph.field.y) &&
+             SDL_ReadS32LE(io, &glyph.field.w) && SDL_ReadS32LE(io, &glyph.field.h) &&
+             SDL_ReadS32LE(io, &glyph.offsetX) && SDL_ReadS32LE(io, &glyph.offsetY) &&
+             SDL_ReadS32LE(io, &glyph.advance);
+        ok = ok && glyph.field.x >= 0 && glyph.field.y >= 0 &&
+             glyph.field.x + glyph.field.w <= fieldWidth && glyph.field.y + glyph.field.h <= fieldHeight;
+    }
+    Uint32 pairCount = 0;
+    ok = ok && SDL_ReadU32LE(io, &pairCount) && pairCount <= SdfGlyphCount * SdfGlyphCount;
+    font.kerning.clear();
+    for (Uint32 i = 0; ok && i < pairCount; ++i) {
+        Uint32 key = 0;
+        Sint32 amount = 0;
+        ok = SDL_ReadU32LE(io, &key) && SDL_ReadS32LE(io, &amount);
+        font.kerning[key] = amount;
+    }
+    font.field.resize(static_cast<size_t>(fieldWidth) * fieldHeight);
+    ok = ok && SDL_ReadIO(io, font.field.data(), font.field.size()) == font.field.size();
+    SDL_CloseIO(io);
+    if (!ok) SDL_Log("SDF cache %s is truncated or corrupt", cachePath.c_str());
+    return ok;
+}
+
+bool loadSdfFont(SdfFont &font, const std::string &cachePath, const std::string &rebakePath,
+                 const std::string &ttfPath)
+{
+    Uint64 start = SDL_GetTicksNS();
+    Uint64 sourceBytes = 0, sourceHash = 0;
+    bool haveSource = fingerprintFile(ttfPath, sourceBytes, sourceHash);
+    bool cached = false;
+    for (const std::string *path : {&cachePath, &rebakePath}) {
+        if (path->empty() || !readSdfFont(font, *path)) continue;
+        //Without the TTF there is nothing to rebake from, any cache will do
+        cached = !haveSource || (font.sourceBytes == sourceBytes && font.sourceHash == sourceHash);
+        if (cached) break;
+    }
+    if (!cached) {
+        if (!bakeSdfFont(font, ttfPath)) return false;
+        if (!rebakePath.empty()) saveSdfFont(font, rebakePath);
+    }
+    font.stats.fromCache = cached;
+    font.stats.loadNS = SDL_GetTicksNS() - start;
+    SDL_Log("SDF font %s in %.2f ms", cached ? "loaded from cache" : "baked",
+            font.stats.loadNS / 1000000.0);
+    return true;
+}
+
+static void releaseResolved(SdfResolvedSize &size)
+{
+    if (size.texture) SDL_DestroyTexture(size.texture);
+    size = SdfResolvedSize();
+}
+
+void closeSdfFont(SdfFont &font)
+{
+    for (SdfResolvedSize &size : font.resolved) {
+        releaseResolved(size);
+    }
+    font.renderer = nullptr;
+}
+
+//Scales the field bilinearly to pixelSize and turns distance into coverage,
+//one output pixel of antialiasing across each edge
+static bool resolveField(SdfFont &font, SdfResolvedSize &size, int pixelSize)
+{
+    float scale = static_cast<float>(pixelSize) / SdfBaseSize;
+    int width = static_cast<int>(std::ceil(font.fieldWidth * scale));
+    int height = static_cast<int>(std::ceil(font.fieldHeight * scale));
+    font.resolveScratch.resize(static_cast<size_t>(width) * height * 4);
+
+    //Field units per output pixel of distance
+    float sharpness = 2.0f * SdfSpread * scale;
+    for (int y = 0; y < height; ++y) {
+        float fy = std::clamp((y + 0.5f) / scale - 0.5f, 0.0f, font.fieldHeight - 1.0f);
+        int y0 = static_cast<int>(fy);
+        int y1 = std::min(y0 + 1, font.fieldHeight - 1);
+        float ty = fy - y0;
+        const Uint8 *row0 = &font.field[static_cast<size_t>(y0) * font.fieldWidth];
+        const Uint8 *row1 = &font.field[static_cast<size_t>(y1) * font.fieldWidth];
+        Uint8 *out = &font.resolveScratch[static_cast<size_t>(y) * width * 4];
+        for (int x = 0; x < width; ++x) {
+            float fx = std::clamp((x + 0.5f) / scale - 0.5f, 0.0f, font.fieldWidth - 1.0f);
+            int x0 = static_cast<int>(fx);
+            int x1 = std::min(x0 + 1, font.fieldWidth - 1);
+            float tx = fx - x0;
+            float top = row0[x0] + (row0[x1] - row0[x0]) * tx;
+            float bottom = row1[x0] + (row1[x1] - row1[x0]) * tx;
+            float value = (top + (bottom - top) * ty) / 255.0f;
+            float coverage = std::clamp((value - 0.5f) * sharpness + 0.5f, 0.0f, 1.0f);
+            out[x * 4 + 0] = 255;
+            out[x * 4 + 1] = 255;
+            out[x * 4 + 2] = 255;
+            out[x * 4 + 3] = static_cast<Uint8>(coverage * 255.0f + 0.5f);
+        }
+    }
+
+    size.texture = SDL_CreateTexture(font.renderer, SDL_PIXELFORMAT_RGBA32,
+                                     SDL_TEXTUREACCESS_STATIC, width, height);
+    if (!size.texture) {
+        SDL_Log("Failed to create %dx%d SDF texture: %s", width, height, SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(size.texture, SDL_BLENDMODE_BLEND);
+    SDL_UpdateTexture(size.texture, nullptr, font.resolveScratch.data(), width * 4);
+    size.pixelSize = pixelSize;
+    size.scale = scale;
+    return true;
+}
+
+static SdfResolvedSize* findResolved(SdfFont &font, RenderBatch &batch, int pixelSize)
+{
+    if (font.renderer != batch.renderer) {
+        flushRenderBatch(batch);
+        closeSdfFont(font);
+        font.renderer = batch.renderer;
+    }
+
+    SdfResolvedSize *slot = &font.resolved[0];
+    for (SdfResolvedSize &size : font.resolved) {
+        if (size.texture && size.pixelSize == pixelSize) {
+            size.lastUsed = SDL_GetTicksNS();
+            return &size;
+        }
+        if (!size.texture || (slot->texture && size.lastUsed < slot->lastUsed)) slot = &size;
+    }
+
+    //Quads already batched may still point at the texture being replaced
+    if (slot->texture) flushRenderBatch(batch);
+    releaseResolved(*slot);
+    Uint64 start = SDL_GetTicksNS();
+    if (!resolveField(font, *slot, pixelSize)) return nullptr;
+    slot->lastUsed = SDL_GetTicksNS();
+    ++font.stats.resolves;
+    font.stats.resolveNS += slot->lastUsed - start;
+    return slot;
+}
+
+static const SdfGlyph* glyphFor(const SdfFont &font, Uint32 codepoint)
+{
+    if (codepoint < SdfFirstCodepoint || codepoint > SdfLastCodepoint) codepoint = '?';
+    return &font.glyphs[codepoint - SdfFirstCodepoint];
+}
+
+static int kerningFor(const SdfFont &font, Uint32 previous, Uint32 codepoint)
+{
+    if (!previous || font.kerning.empty()) return 0;
+    auto found = font.kerning.find(kerningKey(previous, codepoint));
+    return found != font.kerning.end() ? found->second : 0;
+}
+
+bool drawSdfText(SdfFont &font, RenderBatch &batch, const char *text,
+                 float x, float y, float pixelSize, SDL_Color color)
+{
+    if (!text || font.glyphs.empty()) return false;
+
+    //Resolved at whole pixel sizes, the quads carry any fraction
+    int resolvedSize = std::clamp(static_cast<int>(std::lround(pixelSize)), SdfMinPixelSize, SdfMaxPixelSize);
+    SdfResolvedSize *size = findResolved(font, batch, resolvedSize);
+    if (!size) return false;
+
+    float scale = pixelSize / SdfBaseSize;
+    size_t remaining = std::strlen(text);
+    int pen = 0;
+    Uint32 previous = 0;
+    while (remaining > 0) {
+        Uint32 codepoint = SDL_StepUTF8(&text, &remaining);
+        if (codepoint == 0) break;
+        pen += kerningFor(font, previous, codepoint);
+        const SdfGlyph *glyph = glyphFor(font, codepoint);
+        if (glyph->field.w > 0) {
+            SDL_FRect src = {glyph->field.x * size->scale, glyph->field.y * size->scale,
+                             glyph->field.w * size->scale, glyph->field.h * size->scale};
+            SDL_FRect dst = {x + (pen + glyph->offsetX) * scale, y + glyph->offsetY * scale,
+                             glyph->field.w * scale, glyph->field.h * scale};
+            batchTexture(batch, size->texture, &src, &dst, color);
+        }
+        pen += glyph->advance;
+        previous = codepoint;
+    }
+    return true;
+}
+
+bool measureSdfText(const SdfFont &font, const char *text, float pixelSize,
+                    float &width, float &height)
+{
+    if (!text || font.glyphs.empty()) return false;
+
+    size_t remaining = std::strlen(text);
+    int pen = 0;
+    Uint32 previous = 0;
+    while (remaining > 0) {
+        Uint32 codepoint = SDL_StepUTF8(&text, &remaining);
+        if (codepoint == 0) break;
+        pen += kerningFor(font, previous, codepoint) + glyphFor(font, codepoint)->advance;
+        previous = codepoint;
+    }
+    float scale = pixelSize / SdfBaseSize;
+    width = pen * scale;
+    height = font.lineHeight * scale;
+    return true;
+}
+
+void logSdfFontStats(const SdfFont &font)
+{
+    int live = 0;
+    for (const SdfResolvedSize &size : font.resolved) {
+        if (size.texture) ++live;
+    }
+    SDL_Log("SDF font: %dx%d field (%s, %.2f ms), %llu sizes resolved in %.2f ms, %d resident",
+            font.fieldWidth, font.fieldHeight, font.stats.fromCache ? "cached" : "baked",
+            font.stats.loadNS / 1000000.0,
+            static_cast<unsigned long long>(font.stats.resolves),
+            font.stats.resolveNS / 1000000.0, live);
+}
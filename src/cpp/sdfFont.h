@@ -0,0 +1,92 @@
+#ifndef SDF_FONT_H
+#define SDF_FONT_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <SDL3/SDL.h>
+
+#include "renderBatch.h"
+
+//Pixel size glyphs are rasterized at for the field, and how far (in those
+//pixels) the field reaches either side of an edge
+constexpr int SdfBaseSize = 64;
+constexpr int SdfSpread = 8;
+constexpr Uint32 SdfFirstCodepoint = 32;
+constexpr Uint32 SdfLastCodepoint = 126;
+constexpr int SdfFieldWidth = 512;
+//Sizes drawn from are resolved from the field once and kept, least
+//recently used goes first
+constexpr int SdfMaxResolvedSizes = 4;
+constexpr int SdfMinPixelSize = 4;
+constexpr int SdfMaxPixelSize = 256;
+
+struct SdfGlyph
+{
+    SDL_Rect field = {0, 0, 0, 0};  //in the field, spread margin included
+    int offsetX = 0;                //field rect relative to the pen and the line top
+    int offsetY = 0;
+    int advance = 0;
+};
+
+//The field scaled to one pixel size and turned into antialiased coverage
+struct SdfResolvedSize
+{
+    int pixelSize = 0;
+    float scale = 0.0f;
+    SDL_Texture *texture = nullptr;
+    Uint64 lastUsed = 0;
+};
+
+struct SdfFontStats
+{
+    bool fromCache = false;
+    Uint64 loadNS = 0;          //reading the cache, or baking when there wasn't one
+    Uint64 resolves = 0;
+    Uint64 resolveNS = 0;
+};
+
+//One signed distance field holding every printable ASCII glyph of a font.
+//Field texels are 128 on an edge, rising inside the glyph and falling
+//outside it, over SdfSpread base pixels.
+struct SdfFont
+{
+    int lineHeight = 0;         //base pixels
+    int fieldWidth = 0;
+    int fieldHeight = 0;
+    std::vector<Uint8> field;
+    std::vector<SdfGlyph> glyphs;   //SdfFirstCodepoint to SdfLastCodepoint
+    std::unordered_map<Uint32, int> kerning;   //(first << 16 | second) -> base pixels
+    //Identify the TTF the field was baked from
+    Uint64 sourceBytes = 0;
+    Uint64 sourceHash = 0;      //FNV-1a of its contents
+
+    SDL_Renderer *renderer = nullptr;
+    SdfResolvedSize resolved[SdfMaxResolvedSizes];
+    std::vector<Uint8> resolveScratch;
+    SdfFontStats stats;
+};
+
+//Rasterizes the TTF once at SdfBaseSize and builds the field from it
+bool bakeSdfFont(SdfFont &font, const std::string &ttfPath);
+bool saveSdfFont(const SdfFont &font, const std::string &cachePath);
+bool readSdfFont(SdfFont &font, const std::string &cachePath);
+//Reads the shipped cache, or failing that one baked on an earlier run at
+//rebakePath. When neither was baked from this TTF's contents, bakes it and
+//writes the result to rebakePath; the shipped cache is never overwritten,
+//it may sit in a read-only bundle. rebakePath may be empty, and either the
+//caches or the TTF may be missing as long as something works.
+bool loadSdfFont(SdfFont &font, const std::string &cachePath, const std::string &rebakePath,
+                 const std::string &ttfPath);
+//Releases the resolved textures, must run before the renderer is destroyed
+void closeSdfFont(SdfFont &font);
+
+//Adds text at pixelSize with its top-left corner at (x, y) to the batch. The
+//first use of a size resolves it from the field; no glyph is rasterized again.
+bool drawSdfText(SdfFont &font, RenderBatch &batch, const char *text,
+                 float x, float y, float pixelSize, SDL_Color color);
+bool measureSdfText(const SdfFont &font, const char *text, float pixelSize,
+                    float &width, float &height);
+void logSdfFontStats(const SdfFont &font);
+
+#endif
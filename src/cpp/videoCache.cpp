@@ -0,0 +1,305 @@
+#include "videoCache.h"
+
+#include <algorithm>
+
+extern "C"
+{
+    #include <libavutil/imgutils.h>
+}
+
+//Arena frames start on cache-line boundaries
+constexpr size_t CacheFrameAlignment = 64;
+
+struct VideoClipCache
+{
+    SDL_Mutex *mutex = nullptr;
+    std::vector<CachedClip*> clips;
+    size_t byteBudget = 0;
+    double maxDuration = 0.0;
+    VideoCacheStats stats;
+};
+
+static VideoClipCache videoClipCache;
+
+static void lockCache()
+{
+    SDL_LockMutex(videoClipCache.mutex);
+}
+
+static void unlockCache()
+{
+    SDL_UnlockMutex(videoClipCache.mutex);
+}
+
+static void freeClip(CachedClip *clip)
+{
+    if (clip->converter) sws_freeContext(clip->converter);
+    av_free(clip->arena);
+    delete clip;
+}
+
+//Caller holds the lock
+static void removeClip(CachedClip *clip)
+{
+    auto it = std::find(videoClipCache.clips.begin(), videoClipCache.clips.end(), clip);
+    if (it != videoClipCache.clips.end()) videoClipCache.clips.erase(it);
+    videoClipCache.stats.bytesUsed -= clip->arenaBytes + clip->audioCapacity;
+    freeClip(clip);
+}
+
+//Evicts idle clips, oldest first, until bytes more fit. Caller holds the lock.
+static bool makeRoom(size_t bytes)
+{
+    while (videoClipCache.stats.bytesUsed + bytes > videoClipCache.byteBudget) {
+        CachedClip *victim = nullptr;
+        for (CachedClip *clip : videoClipCache.clips) {
+            if (clip->users == 0 && (!victim || clip->lastUsed < victim->lastUsed)) {
+                victim = clip;
+            }
+        }
+        if (!victim) return false;
+        SDL_Log("Video cache evicting %s (%zu bytes)", victim->key.c_str(),
+                victim->arenaBytes + victim->audioCapacity);
+        removeClip(victim);
+        ++videoClipCache.stats.evictions;
+    }
+    return true;
+}
+
+void configureVideoCache(size_t byteBudget, double maxDuration)
+{
+    if (!videoClipCache.mutex) {
+        videoClipCache.mutex = SDL_CreateMutex();
+        if (!videoClipCache.mutex) {
+            SDL_Log("Failed to create video cache mutex: %s", SDL_GetError());
+            return;
+        }
+    }
+    lockCache();
+    videoClipCache.byteBudget = byteBudget;
+    videoClipCache.maxDuration = maxDuration;
+    videoClipCache.stats.byteBudget = byteBudget;
+    makeRoom(0);
+    unlockCache();
+}
+
+double getVideoCacheMaxDuration()
+{
+    return videoClipCache.maxDuration;
+}
+
+CachedClip* acquireCachedClip(const std::string &key)
+{
+    if (!videoClipCache.mutex) return nullptr;
+
+    lockCache();
+    CachedClip *found = nullptr;
+    for (CachedClip *clip : videoClipCache.clips) {
+        if (clip->complete && clip->key == key) {
+            found = clip;
+            break;
+        }
+    }
+    if (found) {
+        ++found->users;
+        found->lastUsed = SDL_GetTicksNS();
+        ++videoClipCache.stats.clipHits;
+    } else {
+        ++videoClipCache.stats.clipMisses;
+    }
+    unlockCache();
+    return found;
+}
+
+CachedClip* beginCachedClip(const std::string &key, int width, int height,
+                            int expectedFrames, double duration, size_t audioBytes)
+{
+    if (!videoClipCache.mutex || width <= 0 || height <= 0 || expectedFrames <= 0) return nullptr;
+    if (duration <= 0.0 || duration > videoClipCache.maxDuration) return nullptr;
+
+    int planeBytes = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, width, height, 1);
+    if (planeBytes <= 0) return nullptr;
+    size_t frameBytes = (static_cast<size_t>(planeBytes) + CacheFrameAlignment - 1) &
+                        ~(CacheFrameAlignment - 1);
+    size_t arenaBytes = frameBytes * static_cast<size_t>(expectedFrames);
+    size_t totalBytes = arenaBytes + audioBytes;
+
+    lockCache();
+    bool fits = totalBytes <= videoClipCache.byteBudget && makeRoom(totalBytes);
+    if (fits) videoClipCache.stats.bytesUsed += totalBytes;
+    unlockCache();
+    if (!fits) {
+        SDL_Log("Video cache: %s needs %zu bytes, over budget", key.c_str(), totalBytes);
+        return nullptr;
+    }
+
+    CachedClip *clip = new CachedClip();
+    clip->key = key;
+    clip->width = width;
+    clip->height = height;
+    clip->capacity = expectedFrames;
+    clip->frameBytes = frameBytes;
+    clip->arenaBytes = arenaBytes;
+    clip->audioCapacity = audioBytes;
+    clip->audio.reserve(audioBytes);
+    clip->duration = duration;
+    clip->arena = static_cast<uint8_t*>(av_malloc(arenaBytes));
+    clip->pts.reserve(expectedFrames);
+    clip->users = 1;
+    if (!clip->arena) {
+        SDL_Log("Video cache: failed to allocate %zu byte arena", arenaBytes);
+        lockCache();
+        videoClipCache.stats.bytesUsed -= totalBytes;
+        unlockCache();
+        delete clip;
+        return nullptr;
+    }
+
+    lockCache();
+    videoClipCache.clips.push_back(clip);
+    unlockCache();
+    return clip;
+}
+
+static void cachedFramePlanes(const CachedClip *clip, int index, uint8_t *data[4], int linesize[4])
+{
+    const uint8_t *base = clip->arena + clip->frameBytes * static_cast<size_t>(index);
+    av_image_fill_arrays(data, linesize, base, AV_PIX_FMT_YUV420P, clip->width, clip->height, 1);
+}
+
+void fillCachedFrame(const CachedClip *clip, int index, AVFrame *frame)
+{
+    cachedFramePlanes(clip, index, frame->data, frame->linesize);
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = clip->width;
+    frame->height = clip->height;
+    frame->color_range = clip->colorRange;
+    frame->colorspace = clip->colorSpace;
+}
+
+bool appendCachedFrame(CachedClip *clip, const AVFrame *frame, double pts, Uint64 decodeNS)
+{
+    if (clip->frameCount >= clip->capacity) return false;
+
+    //Plane pointers straight into the arena, no per-frame AVFrame
+    uint8_t *dstData[4];
+    int dstLinesize[4];
+    cachedFramePlanes(clip, clip->frameCount, dstData, dstLinesize);
+
+    bool copied = true;
+    bool sameSize = frame->width == clip->width && frame->height == clip->height;
+    if (sameSize && (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P)) {
+        int chromaWidth = (clip->width + 1) / 2;
+        int chromaHeight = (clip->height + 1) / 2;
+        av_image_copy_plane(dstData[0], dstLinesize[0], frame->data[0], frame->linesize[0],
+                            clip->width, clip->height);
+        av_image_copy_plane(dstData[1], dstLinesize[1], frame->data[1], frame->linesize[1],
+                            chromaWidth, chromaHeight);
+        av_image_copy_plane(dstData[2], dstLinesize[2], frame->data[2], frame->linesize[2],
+                            chromaWidth, chromaHeight);
+    } else {
+        clip->converter = sws_getCachedContext(
+            clip->converter,
+            frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+            clip->width, clip->height, AV_PIX_FMT_YUV420P,
+            sameSize ? SWS_BILINEAR : SWS_AREA, nullptr, nullptr, nullptr
+        );
+        copied = clip->converter &&
+                 sws_scale(clip->converter, frame->data, frame->linesize, 0, frame->height,
+                           dstData, dstLinesize) >= 0;
+    }
+    if (!copied) return false;
+
+    if (clip->frameCount == 0) {
+        clip->colorRange = (frame->format == AV_PIX_FMT_YUVJ420P) ? AVCOL_RANGE_JPEG : frame->color_range;
+        clip->colorSpace = frame->colorspace;
+    }
+    clip->pts.push_back(pts);
+    clip->decodeNS += decodeNS;
+    ++clip->frameCount;
+    return true;
+}
+
+void appendCachedAudio(CachedClip *clip, const Uint8 *data, size_t bytes)
+{
+    size_t room = clip->audioCapacity - clip->audio.size();
+    if (bytes > room) bytes = room;
+    clip->audio.insert(clip->audio.end(), data, data + bytes);
+}
+
+bool finishCachedClip(CachedClip *clip, double duration)
+{
+    if (clip->frameCount == 0) {
+        abandonCachedClip(clip);
+        return false;
+    }
+    if (clip->converter) {
+        sws_freeContext(clip->converter);
+        clip->converter = nullptr;
+    }
+
+    lockCache();
+    clip->duration = duration;
+    clip->complete = true;
+    clip->lastUsed = SDL_GetTicksNS();
+    unlockCache();
+    SDL_Log("Video cache: stored %s, %d frames, %zu bytes of audio", clip->key.c_str(),
+            clip->frameCount, clip->audio.size());
+    return true;
+}
+
+void abandonCachedClip(CachedClip *clip)
+{
+    lockCache();
+    removeClip(clip);
+    unlockCache();
+}
+
+void releaseCachedClip(CachedClip *clip)
+{
+    lockCache();
+    --clip->users;
+    clip->lastUsed = SDL_GetTicksNS();
+    unlockCache();
+}
+
+void noteCachedFrameServed(const CachedClip *clip)
+{
+    lockCache();
+    ++videoClipCache.stats.framesServed;
+    videoClipCache.stats.decodeTimeSaved +=
+        static_cast<double>(clip->decodeNS) / clip->frameCount / SDL_NS_PER_SECOND;
+    unlockCache();
+}
+
+VideoCacheStats getVideoCacheStats()
+{
+    if (!videoClipCache.mutex) return VideoCacheStats();
+    lockCache();
+    VideoCacheStats stats = videoClipCache.stats;
+    unlockCache();
+    return stats;
+}
+
+void logVideoCacheStats()
+{
+    VideoCacheStats stats = getVideoCacheStats();
+    SDL_Log("Video cache: %llu hits, %llu misses, %llu frames served, %llu evictions, "
+            "%zu/%zu bytes, %.3f s decode saved",
+            static_cast<unsigned long long>(stats.clipHits),
+            static_cast<unsigned long long>(stats.clipMisses),
+            static_cast<unsigned long long>(stats.framesServed),
+            static_cast<unsigned long long>(stats.evictions),
+            stats.bytesUsed, stats.byteBudget, stats.decodeTimeSaved);
+}
+
+void clearVideoCache()
+{
+    if (!videoClipCache.mutex) return;
+    lockCache();
+    for (size_t i = videoClipCache.clips.size(); i-- > 0;) {
+        CachedClip *clip = videoClipCache.clips[i];
+        if (clip->users == 0) removeClip(clip);
+    }
+    unlockCache();
+}
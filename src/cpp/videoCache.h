@@ -0,0 +1,81 @@
+#ifndef VIDEO_CACHE_H
+#define VIDEO_CACHE_H
+
+#include <string>
+#include <vector>
+#include <SDL3/SDL.h>
+
+extern "C"
+{
+    #include <libavutil/frame.h>
+    #include <libswscale/swscale.h>
+}
+
+//A short clip decoded once into one contiguous arena of YUV420P frames.
+//Frames are width*height luma followed by the two quarter-size chroma planes.
+struct CachedClip
+{
+    std::string key;
+    uint8_t *arena = nullptr;
+    size_t arenaBytes = 0;
+    size_t frameBytes = 0;
+    int width = 0;
+    int height = 0;
+    int capacity = 0;
+    int frameCount = 0;
+    std::vector<double> pts;
+    //Soundtrack already resampled to the device format, one pass long
+    std::vector<Uint8> audio;
+    size_t audioCapacity = 0;
+    double duration = 0.0;
+    Uint64 decodeNS = 0;
+    AVColorRange colorRange = AVCOL_RANGE_UNSPECIFIED;
+    AVColorSpace colorSpace = AVCOL_SPC_UNSPECIFIED;
+    bool complete = false;
+    SwsContext *converter = nullptr;    //only while recording non-420P input
+    int users = 0;
+    Uint64 lastUsed = 0;
+};
+
+struct VideoCacheStats
+{
+    Uint64 clipHits = 0;
+    Uint64 clipMisses = 0;
+    Uint64 framesServed = 0;
+    Uint64 evictions = 0;
+    size_t bytesUsed = 0;
+    size_t byteBudget = 0;
+    double decodeTimeSaved = 0.0;   //seconds of demux+decode skipped
+};
+
+//Clips longer than maxDuration or bigger than the byte budget are never
+//cached. When a new clip needs room the least recently used idle clip goes.
+void configureVideoCache(size_t byteBudget, double maxDuration);
+double getVideoCacheMaxDuration();
+
+//Returns a complete cached clip and pins it, or nullptr on a miss
+CachedClip* acquireCachedClip(const std::string &key);
+//Reserves arena space for recording a clip while it is decoded. Returns a
+//pinned, incomplete clip or nullptr if it can't fit in the budget.
+CachedClip* beginCachedClip(const std::string &key, int width, int height,
+                            int expectedFrames, double duration, size_t audioBytes = 0);
+//Copies a decoded frame into the arena, converting to YUV420P and scaling to
+//the clip's size when needed
+bool appendCachedFrame(CachedClip *clip, const AVFrame *frame, double pts, Uint64 decodeNS);
+//Audio past the reserved capacity is dropped rather than growing the clip
+void appendCachedAudio(CachedClip *clip, const Uint8 *data, size_t bytes);
+//Returns false, and drops the clip, when no frame was recorded
+bool finishCachedClip(CachedClip *clip, double duration);
+//Drops a clip that could not be recorded completely
+void abandonCachedClip(CachedClip *clip);
+void releaseCachedClip(CachedClip *clip);
+
+//Points frame at the arena planes of cached frame index without copying
+void fillCachedFrame(const CachedClip *clip, int index, AVFrame *frame);
+void noteCachedFrameServed(const CachedClip *clip);
+
+VideoCacheStats getVideoCacheStats();
+void logVideoCacheStats();
+void clearVideoCache();
+
+#endif
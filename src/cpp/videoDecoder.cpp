@@ -0,0 +1,991 @@
+#include <iostream>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <SDL3/SDL.h>
+
+#include "videoDecoder.h"
+#include "allocationCounter.h"
+#include "colorConvert.h"
+#include "videoCache.h"
+
+extern "C"
+{
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+    #include <libswscale/swscale.h>
+    #include <libswresample/swresample.h>
+}
+
+//Frames later than this behind the clock make the decoder skip
+//non-reference frames; past the keyframe threshold whole GOPs are skipped
+constexpr double NonRefSkipFrames = 2.0;
+constexpr double KeyframeSkipThreshold = 0.5;
+//While the frame queue is full the worker keeps this much soundtrack queued
+//for the device, parking the video packets it demuxes on the way
+constexpr double AudioLeadSeconds = 0.5;
+constexpr int MaxParkedPackets = 64;
+constexpr Sint32 AudioLeadPollMS = 10;
+
+enum class DecodeResult
+{
+    FRAME,
+    END_OF_STREAM,
+    FAILED
+};
+
+//Video packets demuxed ahead of the decoder, oldest first. The packets are
+//allocated once and their references moved in and out.
+struct PacketPark
+{
+    AVPacket *packets[MaxParkedPackets] = {};
+    int readIndex = 0;
+    int count = 0;
+};
+
+//Send/receive state of the video decoder across calls
+struct DecoderState
+{
+    PacketPark *park = nullptr;
+    bool inputEnded = false;        //av_read_frame has nothing more, parked packets may remain
+    bool audioDrained = false;      //the audio decoder and resampler were flushed
+    bool draining = false;          //null packet sent, waiting for AVERROR_EOF
+    bool skipToKeyframe = false;    //discarding packets until the next keyframe
+    CachedClip *recording = nullptr;
+    Uint64 demuxNS = 0;             //spent in av_read_frame since the last frame
+    Uint64 packetsRead = 0;         //each one an av_malloc'd buffer from the demuxer
+};
+
+static void logAVError(const char *what, int err)
+{
+    char message[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(err, message, sizeof(message));
+    SDL_Log("%s: %s", what, message);
+}
+
+static int audioFrameSize(const VideoState &video)
+{
+    return SDL_AUDIO_FRAMESIZE(video.audioSpec);
+}
+
+//Media time up to which audio has been handed to the device stream
+static double queuedAudioTime(const VideoState &video)
+{
+    int bytesPerSecond = audioFrameSize(video) * video.audioSpec.freq;
+    if (bytesPerSecond <= 0) return 0.0;
+    return static_cast<double>(video.audioBytesQueued) / bytesPerSecond;
+}
+
+static void queueAudio(VideoState &video, const Uint8 *data, int bytes, CachedClip *recording)
+{
+    if (bytes <= 0) return;
+    if (!SDL_PutAudioStreamData(video.audioStream, data, bytes)) {
+        SDL_Log("Failed to queue video audio: %s", SDL_GetError());
+        return;
+    }
+    video.audioBytesQueued += bytes;
+    if (recording) appendCachedAudio(recording, data, bytes);
+}
+
+//Fills the audio timeline with silence up to mediaTime, so a pass whose
+//audio is shorter than its video still starts the next loop in sync
+static void padAudioTo(VideoState &video, double mediaTime)
+{
+    if (!video.audioStream) return;
+    int frameSize = audioFrameSize(video);
+    Uint64 target = static_cast<Uint64>(mediaTime * video.audioSpec.freq) * frameSize;
+    static const Uint8 silence[4096] = {0};
+    while (video.audioBytesQueued < target) {
+        Uint64 remaining = target - video.audioBytesQueued;
+        int bytes = static_cast<int>(remaining < sizeof(silence) ? remaining : sizeof(silence));
+        queueAudio(video, silence, bytes, nullptr);
+    }
+}
+
+//Converts one decoded frame (or, with nullptr, whatever swresample still
+//buffers) to the device format and appends it to the stream
+static void resampleAudio(VideoState &video, const AVFrame *frame, CachedClip *recording)
+{
+    int inSamples = frame ? frame->nb_samples : 0;
+    int outSamples = swr_get_out_samples(video.swrCtx, inSamples);
+    if (outSamples <= 0) return;
+
+    size_t needed = static_cast<size_t>(outSamples) * audioFrameSize(video);
+    if (video.audioPcm.size() < needed) video.audioPcm.resize(needed);
+
+    uint8_t *out[1] = { video.audioPcm.data() };
+    int converted = swr_convert(video.swrCtx, out, outSamples,
+                                frame ? frame->extended_data : nullptr, inSamples);
+    if (converted < 0) {
+        logAVError("swr_convert failed", converted);
+        return;
+    }
+    queueAudio(video, video.audioPcm.data(), converted * audioFrameSize(video), recording);
+}
+
+//Decodes every audio frame a packet yields. A null packet drains the
+//decoder and resampler at the end of a pass.
+static void decodeAudioPacket(VideoState &video, const AVPacket *packet, CachedClip *recording)
+{
+    int ret = avcodec_send_packet(video.pAudioCodecCtx, packet);
+    if (ret < 0 && packet) {
+        logAVError("Audio avcodec_send_packet failed", ret);
+        return;
+    }
+    while (avcodec_receive_frame(video.pAudioCodecCtx, video.pAudioFrame) == 0) {
+        resampleAudio(video, video.pAudioFrame, recording);
+        av_frame_unref(video.pAudioFrame);
+    }
+    if (!packet) {
+        resampleAudio(video, nullptr, recording);
+    }
+}
+
+static bool hasVideoAudio(const VideoState &video)
+{
+    return video.audioStream && video.pAudioCodecCtx && video.swrCtx;
+}
+
+//Seconds of soundtrack handed to the device stream and not yet played
+static double audioLead(const VideoState &video)
+{
+    int bytesPerSecond = audioFrameSize(video) * video.audioSpec.freq;
+    if (!video.audioStream || bytesPerSecond <= 0) return 0.0;
+    return static_cast<double>(SDL_GetAudioStreamQueued(video.audioStream)) / bytesPerSecond;
+}
+
+static void flushVideoAudio(VideoState &video, DecoderState &state)
+{
+    if (state.audioDrained) return;
+    state.audioDrained = true;
+    if (hasVideoAudio(video)) decodeAudioPacket(video, nullptr, state.recording);
+}
+
+//Next packet for the decoders: whatever was parked comes first, then the
+//demuxer. At the end of input the soundtrack is flushed.
+static int readPacket(VideoState &video, DecoderState &state, AVPacket *packet)
+{
+    PacketPark &park = *state.park;
+    if (park.count > 0) {
+        av_packet_move_ref(packet, park.packets[park.readIndex]);
+        park.readIndex = (park.readIndex + 1) % MaxParkedPackets;
+        --park.count;
+        return 0;
+    }
+    if (state.inputEnded) return AVERROR_EOF;
+
+    Uint64 readStart = SDL_GetTicksNS();
+    int ret = av_read_frame(video.pFormatCtx, packet);
+    state.demuxNS += SDL_GetTicksNS() - readStart;
+    if (ret >= 0) {
+        ++state.packetsRead;
+        return ret;
+    }
+    if (ret != AVERROR_EOF) logAVError("av_read_frame failed", ret);
+    state.inputEnded = true;
+    flushVideoAudio(video, state);
+    return ret;
+}
+
+//Demuxes one packet while the frame queue is full so the soundtrack never
+//waits on the renderer: audio is decoded straight into the device stream,
+//video is parked for the decoder. Returns false when there is nothing to do
+//(enough audio queued, nowhere to park, or no more input).
+static bool readAudioAhead(VideoState &video, DecoderState &state, AVPacket *packet)
+{
+    PacketPark &park = *state.park;
+    if (!hasVideoAudio(video) || state.inputEnded || park.count == MaxParkedPackets ||
+        audioLead(video) >= AudioLeadSeconds) {
+        return false;
+    }
+
+    Uint64 readStart = SDL_GetTicksNS();
+    int ret = av_read_frame(video.pFormatCtx, packet);
+    state.demuxNS += SDL_GetTicksNS() - readStart;
+    if (ret < 0) {
+        if (ret != AVERROR_EOF) logAVError("av_read_frame failed", ret);
+        state.inputEnded = true;
+        flushVideoAudio(video, state);
+        return false;
+    }
+    ++state.packetsRead;
+    if (packet->stream_index == video.audioStreamIndex) {
+        decodeAudioPacket(video, packet, state.recording);
+        av_packet_unref(packet);
+    } else if (packet->stream_index == video.videoStream) {
+        int slot = (park.readIndex + park.count) % MaxParkedPackets;
+        av_packet_move_ref(park.packets[slot], packet);
+        ++park.count;
+    } else {
+        av_packet_unref(packet);
+    }
+    return true;
+}
+
+//The cached counterpart: releases recorded soundtrack ahead of the frames
+static bool releaseCachedAudioAhead(VideoState &video, const CachedClip *replay, size_t &replayAudioPos)
+{
+    if (!video.audioStream || replayAudioPos >= replay->audio.size()) return false;
+    double missing = AudioLeadSeconds - audioLead(video);
+    if (missing <= 0.0) return false;
+
+    int frameSize = audioFrameSize(video);
+    size_t bytes = static_cast<size_t>(missing * video.audioSpec.freq + 1) * frameSize;
+    bytes = std::min(bytes, replay->audio.size() - replayAudioPos);
+    queueAudio(video, replay->audio.data() + replayAudioPos, static_cast<int>(bytes), nullptr);
+    replayAudioPos += bytes;
+    return true;
+}
+
+//Pulls the next frame out of the decoder, feeding it packets as it asks for
+//them. A packet can yield several frames (or none), and at end of file the
+//decoder is drained so its delayed frames still come out.
+static DecodeResult decodeNextFrame(VideoState &video, DecoderState &state,
+                                    AVPacket *packet, AVFrame *frame)
+{
+    for (;;) {
+        int ret = avcodec_receive_frame(video.pCodecCtx, frame);
+        if (ret == 0) {
+            return DecodeResult::FRAME;
+        }
+        if (ret == AVERROR_EOF) {
+            return DecodeResult::END_OF_STREAM;
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            logAVError("avcodec_receive_frame failed", ret);
+            return DecodeResult::FAILED;
+        }
+        if (state.draining) {
+            return DecodeResult::END_OF_STREAM;
+        }
+
+        ret = readPacket(video, state, packet);
+        if (ret < 0) {
+            state.draining = true;
+            avcodec_send_packet(video.pCodecCtx, nullptr);
+            continue;
+        }
+        if (packet->stream_index == video.audioStreamIndex && hasVideoAudio(video)) {
+            decodeAudioPacket(video, packet, state.recording);
+            av_packet_unref(packet);
+            continue;
+        }
+        if (packet->stream_index != video.videoStream) {
+            av_packet_unref(packet);
+            continue;
+        }
+        if (state.skipToKeyframe) {
+            if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+                ++video.stats.packetsSkipped;
+                av_packet_unref(packet);
+                continue;
+            }
+            state.skipToKeyframe = false;
+        }
+
+        //receive_frame just returned EAGAIN, so the decoder can take this packet
+        ret = avcodec_send_packet(video.pCodecCtx, packet);
+        av_packet_unref(packet);
+        if (ret < 0 && ret != AVERROR(EAGAIN)) {
+            //A corrupt packet shouldn't end playback, the next keyframe recovers
+            logAVError("avcodec_send_packet failed", ret);
+        }
+    }
+}
+
+//How far behind the presentation clock a frame at pts would be
+static double frameLateness(const VideoState &video, double pts)
+{
+    double clock = video.presentClock;
+    return (clock < 0.0) ? 0.0 : clock - pts;
+}
+
+//Adjusts how much work the decoder skips based on how late its output is
+static void updateSkipPolicy(VideoState &video, DecoderState &state, double lateness, bool recording)
+{
+    //Every frame has to reach the cache while a pass is being recorded
+    if (recording) return;
+
+    if (lateness > KeyframeSkipThreshold) {
+        if (!state.skipToKeyframe) {
+            SDL_Log("Video %.3f s behind, skipping to next keyframe", lateness);
+        }
+        state.skipToKeyframe = true;
+    }
+    AVDiscard skip = (lateness > NonRefSkipFrames * video.frameDuration) ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    if (video.pCodecCtx->skip_frame != skip) {
+        video.pCodecCtx->skip_frame = skip;
+    }
+}
+
+static bool isDirectUploadFormat(int format)
+{
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P || format == AV_PIX_FMT_NV12;
+}
+
+//Slot buffers are only reallocated when the output geometry changes
+static bool ensureSlotBuffer(AVFrame *dst, AVPixelFormat format, int width, int height)
+{
+    if (dst->data[0] && dst->format == format && dst->width == width && dst->height == height) {
+        return true;
+    }
+    av_frame_unref(dst);
+    dst->format = format;
+    dst->width = width;
+    dst->height = height;
+    if (av_frame_get_buffer(dst, 0) < 0) {
+        std::cerr << "Failed to allocate frame slot buffer\n";
+        return false;
+    }
+    return true;
+}
+
+//Size a frame is delivered at: fitted inside the target keeping its aspect,
+//never enlarged, and even so 4:2:0 chroma stays whole
+static void outputSize(const VideoState &video, int frameWidth, int frameHeight, int &width, int &height)
+{
+    width = frameWidth;
+    height = frameHeight;
+    if (video.targetWidth <= 0 || video.targetHeight <= 0) return;
+    if (frameWidth <= video.targetWidth && frameHeight <= video.targetHeight) return;
+
+    double scale = std::min(static_cast<double>(video.targetWidth) / frameWidth,
+                            static_cast<double>(video.targetHeight) / frameHeight);
+    width = std::max(2, static_cast<int>(frameWidth * scale) & ~1);
+    height = std::max(2, static_cast<int>(frameHeight * scale) & ~1);
+}
+
+static bool convertFrame(VideoState &video, const AVFrame *frame, AVFrame *dst, AVPixelFormat dstFormat,
+                         int width, int height)
+{
+    //Frame geometry rather than the codec's, lowres decoding shrinks the output
+    bool scaling = width != frame->width || height != frame->height;
+    video.swsCtx = sws_getCachedContext(
+        video.swsCtx,
+        frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+        width, height, dstFormat,
+        scaling ? SWS_AREA : SWS_BILINEAR, nullptr, nullptr, nullptr
+    );
+    if (!video.swsCtx) {
+        std::cerr << "Failed to create SwsContext\n";
+        return false;
+    }
+
+    if (!ensureSlotBuffer(dst, dstFormat, width, height)) {
+        return false;
+    }
+
+    if (sws_scale(video.swsCtx, frame->data, frame->linesize, 0, frame->height,
+                  dst->data, dst->linesize) < 0) {
+        std::cerr << "sws_scale failed\n";
+        return false;
+    }
+    dst->color_range = frame->color_range;
+    dst->colorspace = frame->colorspace;
+    return true;
+}
+
+//Same-size 4:2:0 input goes through the built-in SIMD kernels, anything
+//else (including a downscale) through swscale. Both produce RGBA.
+static bool convertFrameRGBA(VideoState &video, const AVFrame *frame, AVFrame *dst, int width, int height)
+{
+    if (!isDirectUploadFormat(frame->format) || width != frame->width || height != frame->height) {
+        return convertFrame(video, frame, dst, AV_PIX_FMT_RGBA, width, height);
+    }
+    if (!ensureSlotBuffer(dst, AV_PIX_FMT_RGBA, frame->width, frame->height)) {
+        return false;
+    }
+    convertFrameToRGBA(frame, RGBAOrder::RGBA, dst->data[0], dst->linesize[0]);
+    dst->color_range = frame->color_range;
+    dst->colorspace = frame->colorspace;
+    return true;
+}
+
+//Position of a frame within one pass of the clip
+static double framePosition(const VideoState &video, const AVFrame *frame)
+{
+    AVStream *stream = video.pFormatCtx->streams[video.videoStream];
+    int64_t pts = frame->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE) return 0.0;
+    if (stream->start_time != AV_NOPTS_VALUE) pts -= stream->start_time;
+    return pts * av_q2d(stream->time_base);
+}
+
+//Seeks back to the keyframe at the start of the clip and drops whatever the
+//decoder still holds from the previous pass
+static bool rewindVideo(VideoState &video)
+{
+    AVStream *stream = video.pFormatCtx->streams[video.videoStream];
+    int64_t start = (stream->start_time != AV_NOPTS_VALUE) ? stream->start_time : 0;
+    if (av_seek_frame(video.pFormatCtx, video.videoStream, start, AVSEEK_FLAG_BACKWARD) < 0) {
+        SDL_Log("Failed to seek video back to start");
+        return false;
+    }
+    avcodec_flush_buffers(video.pCodecCtx);
+    video.pCodecCtx->skip_frame = AVDISCARD_DEFAULT;
+    if (video.pAudioCodecCtx) avcodec_flush_buffers(video.pAudioCodecCtx);
+    return true;
+}
+
+//Hands a decoded frame to a queue slot. Planar 4:2:0 output is passed by
+//reference so the render thread uploads the decoder's own planes.
+static bool storeFrame(VideoState &video, AVFrame *frame, double pts, VideoFrameSlot &slot)
+{
+    slot.pts = pts;
+    int width, height;
+    outputSize(video, frame->width, frame->height, width, height);
+    bool fitted = width == frame->width && height == frame->height;
+
+    if (video.playbackMode == VideoPlaybackMode::STREAMING_YUV) {
+        if (fitted && isDirectUploadFormat(frame->format)) {
+            av_frame_unref(slot.frame);
+            av_frame_move_ref(slot.frame, frame);
+            slot.borrowed = true;
+            return true;
+        }
+        slot.borrowed = false;
+        return convertFrame(video, frame, slot.frame, AV_PIX_FMT_YUV420P, width, height);
+    }
+    slot.borrowed = false;
+    return convertFrameRGBA(video, frame, slot.frame, width, height);
+}
+
+//Clips delivered at different sizes (lowres tiers, window fits) are cached
+//separately, and stored at the size they are shown at
+static std::string cacheKey(const VideoState &video)
+{
+    int width, height;
+    outputSize(video, video.pCodecCtx->width, video.pCodecCtx->height, width, height);
+    return video.sourcePath + "@" + std::to_string(width) + "x" + std::to_string(height);
+}
+
+//Starts recording the first pass into the clip cache if the clip is short
+//enough to qualify
+static CachedClip* beginRecording(VideoState &video)
+{
+    double duration = video.clipDuration;
+    if (duration <= 0.0 || duration > getVideoCacheMaxDuration() || video.frameDuration <= 0.0) {
+        return nullptr;
+    }
+    //A couple of spare frames for rounding in the container's duration
+    int expectedFrames = static_cast<int>(std::ceil(duration / video.frameDuration)) + 2;
+    int width, height;
+    outputSize(video, video.pCodecCtx->width, video.pCodecCtx->height, width, height);
+    //Soundtrack PCM is kept alongside the frames, with half a second of slack
+    size_t audioBytes = 0;
+    if (hasVideoAudio(video)) {
+        audioBytes = static_cast<size_t>((duration + 0.5) * video.audioSpec.freq) * audioFrameSize(video);
+    }
+    return beginCachedClip(cacheKey(video), width, height, expectedFrames, duration, audioBytes);
+}
+
+static int videoDecodeThread(void *data)
+{
+    VideoState &video = *static_cast<VideoState*>(data);
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    PacketPark park;
+    bool allocated = packet && frame;
+    for (AVPacket *&parked : park.packets) {
+        parked = allocated ? av_packet_alloc() : nullptr;
+        allocated = allocated && parked;
+    }
+    if (!allocated) {
+        SDL_Log("Decoder worker failed to allocate packet/frame");
+        for (AVPacket *&parked : park.packets) av_packet_free(&parked);
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        video.decodeFinished = true;
+        return -1;
+    }
+
+    //Media time of the start of the current pass and the end of the furthest
+    //frame seen in it, so PTS stay monotonic when the clip loops
+    double loopOffset = 0.0;
+    double passEnd = 0.0;
+
+    //Cache mode: replay a clip decoded on an earlier visit, or record this
+    //pass so later loops skip demuxing and decoding entirely
+    CachedClip *replay = video.cacheEnabled ? acquireCachedClip(cacheKey(video)) : nullptr;
+    CachedClip *recording = nullptr;
+    int replayIndex = 0;
+    size_t replayAudioPos = 0;
+    DecoderState decoder;
+    decoder.park = &park;
+    if (video.cacheEnabled && !replay) {
+        recording = beginRecording(video);
+    }
+    decoder.recording = recording;
+
+    //Once the first frame is out every buffer the loop owns exists: the
+    //packet and frame above (reused for every read), the slot frames, the
+    //decoder's own buffer pool and the resampler output. SDL and C++
+    //allocations after that are counted. The demuxer still hands each packet
+    //a fresh av_malloc'd buffer that no hook can see, so those are counted
+    //by packet instead.
+    bool steadyState = false;
+    Uint64 allocationMark = getThreadAllocationCount();
+
+    while (video.decodeRunning) {
+        Uint64 allocations = getThreadAllocationCount();
+        if (steadyState) {
+            video.stats.steadySdlAndNewAllocations += allocations - allocationMark;
+            video.stats.steadyPacketsDemuxed += decoder.packetsRead;
+        }
+        decoder.packetsRead = 0;
+        allocationMark = allocations;
+
+        //A full queue only holds back the picture, the soundtrack is kept
+        //ahead meanwhile so the audio clock never stalls on the renderer
+        VideoFrameSlot *slot = waitWritableSlot(video.frameQueue, 0);
+        while (!slot && !isFrameQueueAborted(video.frameQueue)) {
+            bool fed = replay ? releaseCachedAudioAhead(video, replay, replayAudioPos)
+                              : readAudioAhead(video, decoder, packet);
+            slot = waitWritableSlot(video.frameQueue, fed ? 0 : AudioLeadPollMS);
+        }
+        if (!slot) break;
+
+        if (replay) {
+            double pts = loopOffset + replay->pts[replayIndex];
+            bool late = frameLateness(video, pts) > video.frameDuration;
+            if (late) {
+                ++video.stats.framesDiscarded;
+            } else {
+                av_frame_unref(slot->frame);
+                fillCachedFrame(replay, replayIndex, slot->frame);
+                slot->borrowed = true;
+                slot->pts = pts;
+                noteCachedFrameServed(replay);
+                commitWritableSlot(video.frameQueue);
+                steadyState = true;
+            }
+
+            //Cached soundtrack is released in step with the frames, and all
+            //of it with the last one: the soundtrack may run past the picture
+            if (video.audioStream && !replay->audio.empty()) {
+                int frameSize = audioFrameSize(video);
+                double until = replay->pts[replayIndex] + video.frameDuration;
+                size_t end = static_cast<size_t>(until * video.audioSpec.freq) * frameSize;
+                if (end > replay->audio.size() || replayIndex + 1 == replay->frameCount) {
+                    end = replay->audio.size();
+                }
+                if (end > replayAudioPos) {
+                    queueAudio(video, replay->audio.data() + replayAudioPos,
+                               static_cast<int>(end - replayAudioPos), nullptr);
+                    replayAudioPos = end;
+                }
+            }
+
+            if (++replayIndex == replay->frameCount) {
+                if (!video.looping) break;
+                loopOffset += replay->duration;
+                padAudioTo(video, loopOffset);
+                replayIndex = 0;
+                replayAudioPos = 0;
+                video.clipDuration = replay->duration;
+            }
+            continue;
+        }
+
+        Uint64 decodeStart = SDL_GetTicksNS();
+        decoder.demuxNS = 0;
+        DecodeResult result = decodeNextFrame(video, decoder, packet, frame);
+        if (result == DecodeResult::FAILED) {
+            break;
+        }
+        if (result == DecodeResult::END_OF_STREAM) {
+            //A pass lasts until both its picture and its soundtrack have ended
+            double audioEnd = queuedAudioTime(video) - loopOffset;
+            if (hasVideoAudio(video) && audioEnd > passEnd) passEnd = audioEnd;
+
+            bool replaying = false;
+            if (recording) {
+                //The whole pass is in the arena now, switch over to it. A pass
+                //that ended before any frame was decoded leaves nothing to replay.
+                replaying = finishCachedClip(recording, passEnd);
+                if (replaying) {
+                    replay = recording;
+                    replayIndex = 0;
+                    replayAudioPos = 0;
+                }
+                recording = nullptr;
+                decoder.recording = nullptr;
+            }
+            if (!replaying && (!video.looping || passEnd <= 0.0 || !rewindVideo(video))) {
+                SDL_Log("Decoder worker reached end of stream");
+                break;
+            }
+            if (!video.looping) break;
+            decoder = DecoderState();
+            decoder.park = &park;
+            video.clipDuration = passEnd;
+            loopOffset += passEnd;
+            padAudioTo(video, loopOffset);
+            passEnd = 0.0;
+            continue;
+        }
+        Uint64 decodeNS = SDL_GetTicksNS() - decodeStart;
+        ++video.stats.framesDecoded;
+
+        double position = framePosition(video, frame);
+        if (position + video.frameDuration > passEnd) {
+            passEnd = position + video.frameDuration;
+        }
+        if (recording && !appendCachedFrame(recording, frame, position, decodeNS)) {
+            SDL_Log("Video cache: %s doesn't fit its reservation, not caching", video.sourcePath.c_str());
+            abandonCachedClip(recording);
+            recording = nullptr;
+            decoder.recording = nullptr;
+        }
+
+        //Already behind the clock: don't spend a conversion and a slot on it
+        double lateness = frameLateness(video, loopOffset + position);
+        updateSkipPolicy(video, decoder, lateness, recording != nullptr);
+        if (lateness > video.frameDuration) {
+            ++video.stats.framesDiscarded;
+            av_frame_unref(frame);
+            continue;
+        }
+
+        Uint64 convertStart = SDL_GetTicksNS();
+        bool stored = storeFrame(video, frame, loopOffset + position, *slot);
+        av_frame_unref(frame);
+        if (!stored) break;
+        if (video.stageTimings) {
+            video.stageTimings->demuxNS.push_back(decoder.demuxNS);
+            video.stageTimings->decodeNS.push_back(decodeNS - decoder.demuxNS);
+            video.stageTimings->convertNS.push_back(SDL_GetTicksNS() - convertStart);
+        }
+
+        commitWritableSlot(video.frameQueue);
+        steadyState = true;
+    }
+
+    if (recording) abandonCachedClip(recording);
+    if (replay) releaseCachedClip(replay);
+    for (AVPacket *&parked : park.packets) av_packet_free(&parked);
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    video.decodeFinished = true;
+    return 0;
+}
+
+bool openVideoAudio(VideoState &video)
+{
+    if (!video.pAudioCodecCtx || !video.audioDevice) return false;
+
+    SDL_AudioSpec deviceSpec;
+    if (!SDL_GetAudioDeviceFormat(video.audioDevice, &deviceSpec, nullptr)) {
+        deviceSpec = video.audioSpec;
+    }
+    video.audioStream = SDL_CreateAudioStream(&video.audioSpec, &deviceSpec);
+    if (!video.audioStream) {
+        SDL_Log("Failed to create video audio stream: %s", SDL_GetError());
+        return false;
+    }
+
+    AVChannelLayout outLayout;
+    av_channel_layout_default(&outLayout, video.audioSpec.channels);
+    int result = swr_alloc_set_opts2(&video.swrCtx,
+                                     &outLayout, AV_SAMPLE_FMT_S16, video.audioSpec.freq,
+                                     &video.pAudioCodecCtx->ch_layout,
+                                     video.pAudioCodecCtx->sample_fmt,
+                                     video.pAudioCodecCtx->sample_rate,
+                                     0, nullptr);
+    av_channel_layout_uninit(&outLayout);
+    if (result < 0 || (result = swr_init(video.swrCtx)) < 0) {
+        logAVError("Failed to set up audio resampler", result);
+        swr_free(&video.swrCtx);
+        SDL_DestroyAudioStream(video.audioStream);
+        video.audioStream = nullptr;
+        return false;
+    }
+
+    video.audioBytesQueued = 0;
+    if (!video.paused && !SDL_BindAudioStream(video.audioDevice, video.audioStream)) {
+        SDL_Log("Failed to bind video audio stream: %s", SDL_GetError());
+    }
+    return true;
+}
+
+bool startVideoDecoder(VideoState &video)
+{
+    if (video.decodeThread) return true;
+    if (!video.pFormatCtx || !video.pCodecCtx) return false;
+
+    if (!video.frameQueue.mutex && !initFrameQueue(video.frameQueue)) {
+        return false;
+    }
+    resetFrameQueue(video.frameQueue);
+
+    AVStream *stream = video.pFormatCtx->streams[video.videoStream];
+    if (stream->avg_frame_rate.num > 0 && stream->avg_frame_rate.den > 0) {
+        video.frameDuration = av_q2d(av_inv_q(stream->avg_frame_rate));
+    }
+    if (video.pFormatCtx->duration > 0) {
+        video.clipDuration = static_cast<double>(video.pFormatCtx->duration) / AV_TIME_BASE;
+    }
+    //A video paused before it starts (a prefetch) holds at zero until resumed
+    resetPlaybackClock(video.clock);
+    video.presentClock = -1.0;
+
+    video.decodeFinished = false;
+    video.decodeRunning = true;
+    video.decodeThread = SDL_CreateThread(videoDecodeThread, "VideoDecoder", &video);
+    if (!video.decodeThread) {
+        SDL_Log("Failed to start decoder worker: %s", SDL_GetError());
+        video.decodeRunning = false;
+        return false;
+    }
+    return true;
+}
+
+void stopVideoDecoder(VideoState &video)
+{
+    if (!video.decodeThread) return;
+
+    video.decodeRunning = false;
+    abortFrameQueue(video.frameQueue);
+    SDL_WaitThread(video.decodeThread, nullptr);
+    video.decodeThread = nullptr;
+
+    for (VideoFrameSlot &slot : video.frameQueue.slots) {
+        if (slot.borrowed) {
+            av_frame_unref(slot.frame);
+            slot.borrowed = false;
+        }
+    }
+    resetFrameQueue(video.frameQueue);
+}
+
+static SDL_Colorspace frameColorspace(const AVFrame *frame)
+{
+    bool fullRange = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P;
+    if (frame->colorspace == AVCOL_SPC_BT709) {
+        return fullRange ? SDL_COLORSPACE_BT709_FULL : SDL_COLORSPACE_BT709_LIMITED;
+    }
+    return fullRange ? SDL_COLORSPACE_BT601_FULL : SDL_COLORSPACE_BT601_LIMITED;
+}
+
+//(Re)creates the streaming texture only when the frame layout changes
+static bool ensureVideoTexture(VideoState &video, SDL_Renderer* renderer, const AVFrame *frame,
+                               SDL_PixelFormat format)
+{
+    if (video.videoTexture && video.videoTexture->format == format &&
+        video.videoTexture->w == frame->width && video.videoTexture->h == frame->height) {
+        return true;
+    }
+    destroyVideoTexture(video);
+
+    SDL_PropertiesID props = SDL_CreateProperties();
+    SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_FORMAT_NUMBER, format);
+    SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_ACCESS_NUMBER, SDL_TEXTUREACCESS_STREAMING);
+    SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_WIDTH_NUMBER, frame->width);
+    SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_HEIGHT_NUMBER, frame->height);
+    if (format != SDL_PIXELFORMAT_RGBA32) {
+        SDL_SetNumberProperty(props, SDL_PROP_TEXTURE_CREATE_COLORSPACE_NUMBER, frameColorspace(frame));
+    }
+    video.videoTexture = SDL_CreateTextureWithProperties(renderer, props);
+    SDL_DestroyProperties(props);
+
+    if (!video.videoTexture) {
+        std::cerr << "Failed to create video texture: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool uploadFrame(VideoState &video, SDL_Renderer* renderer, const AVFrame *frame)
+{
+    switch (frame->format) {
+        case AV_PIX_FMT_NV12:
+            return ensureVideoTexture(video, renderer, frame, SDL_PIXELFORMAT_NV12) &&
+                   SDL_UpdateNVTexture(video.videoTexture, nullptr,
+                                       frame->data[0], frame->linesize[0],
+                                       frame->data[1], frame->linesize[1]);
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+            return ensureVideoTexture(video, renderer, frame, SDL_PIXELFORMAT_IYUV) &&
+                   SDL_UpdateYUVTexture(video.videoTexture, nullptr,
+                                        frame->data[0], frame->linesize[0],
+                                        frame->data[1], frame->linesize[1],
+                                        frame->data[2], frame->linesize[2]);
+        case AV_PIX_FMT_RGBA:
+            return ensureVideoTexture(video, renderer, frame, SDL_PIXELFORMAT_RGBA32) &&
+                   SDL_UpdateTexture(video.videoTexture, nullptr, frame->data[0], frame->linesize[0]);
+        default:
+            std::cerr << "Unexpected frame format in queue: " << frame->format << std::endl;
+            return false;
+    }
+}
+
+//Returns the slot to the worker, dropping any decoder buffers it borrowed
+static void releaseSlot(VideoState &video, VideoFrameSlot *slot)
+{
+    if (slot->borrowed) {
+        av_frame_unref(slot->frame);
+        slot->borrowed = false;
+    }
+    releaseReadableSlot(video.frameQueue);
+}
+
+static SDL_Texture* uploadSlot(VideoState &video, SDL_Renderer* renderer, VideoFrameSlot *slot)
+{
+    bool uploaded = uploadFrame(video, renderer, slot->frame);
+    if (!uploaded && video.videoTexture) {
+        std::cerr << "Failed to upload video frame: " << SDL_GetError() << std::endl;
+    }
+    releaseSlot(video, slot);
+    return uploaded ? video.videoTexture : nullptr;
+}
+
+void pauseVideo(VideoState &video)
+{
+    if (video.paused) return;
+    video.paused = true;
+    pausePlaybackClock(video.clock);
+    //Unbinding stops consumption but keeps the queued soundtrack in place
+    if (video.audioStream) SDL_UnbindAudioStream(video.audioStream);
+}
+
+void resumeVideo(VideoState &video)
+{
+    if (!video.paused) return;
+    video.paused = false;
+    resumePlaybackClock(video.clock);
+    if (video.audioStream && video.audioDevice) {
+        SDL_BindAudioStream(video.audioDevice, video.audioStream);
+    }
+}
+
+bool getVideoAudioClock(VideoState &video, double &audioTime)
+{
+    if (video.paused) return false;
+    return getAudioStreamClock(video.audioStream, video.audioDevice, video.audioSpec,
+                               video.audioBytesQueued, audioTime);
+}
+
+double getVideoClipPosition(VideoState &video)
+{
+    double duration = video.clipDuration;
+    double time = getPlaybackClock(video.clock);
+    if (duration <= 0.0) return time;
+    return std::fmod(time, duration);
+}
+
+void logVideoPlaybackStats(const VideoState &video)
+{
+    SDL_Log("Video playback: %llu decoded, %llu presented, %llu late, %llu dropped at present, "
+            "%llu discarded by decoder, %llu packets skipped to keyframe",
+            static_cast<unsigned long long>(video.stats.framesDecoded),
+            static_cast<unsigned long long>(video.stats.framesPresented),
+            static_cast<unsigned long long>(video.stats.framesLate),
+            static_cast<unsigned long long>(video.stats.framesDropped),
+            static_cast<unsigned long long>(video.stats.framesDiscarded),
+            static_cast<unsigned long long>(video.stats.packetsSkipped));
+    if (allocationCounterEnabled()) {
+        SDL_Log("Video playback after the first frame: %llu SDL/new allocations, "
+                "%llu packets demuxed into av_malloc'd buffers (not hookable)",
+                static_cast<unsigned long long>(video.stats.steadySdlAndNewAllocations),
+                static_cast<unsigned long long>(video.stats.steadyPacketsDemuxed));
+    }
+}
+
+void closeVideo(VideoState &video)
+{
+    stopVideoDecoder(video);
+    destroyVideoTexture(video);
+    if (video.swsCtx) {
+        sws_freeContext(video.swsCtx);
+        video.swsCtx = nullptr;
+    }
+    if (video.audioStream) {
+        SDL_DestroyAudioStream(video.audioStream);
+        video.audioStream = nullptr;
+    }
+    //Destroying the stream unbound it, the device belongs to the audio engine
+    video.audioDevice = 0;
+    if (video.swrCtx) {
+        swr_free(&video.swrCtx);
+    }
+    if (video.pAudioFrame) {
+        av_frame_free(&video.pAudioFrame);
+    }
+    if (video.pAudioCodecCtx) {
+        avcodec_free_context(&video.pAudioCodecCtx);
+    }
+    video.audioStreamIndex = -1;
+    video.audioBytesQueued = 0;
+    if (video.pCodecCtx) {
+        avcodec_free_context(&video.pCodecCtx);
+    }
+    if (video.pFormatCtx) {
+        avformat_close_input(&video.pFormatCtx);
+    }
+    closeMappedMedia(video.media);
+    video.videoStream = -1;
+    video.clipDuration = 0.0;
+    video.paused = false;
+}
+
+SDL_Texture* getNextFrame(VideoState &video, SDL_Renderer* renderer)
+{
+    VideoFrameSlot *slot = peekReadableSlot(video.frameQueue);
+    if (!slot) return nullptr;
+    return uploadSlot(video, renderer, slot);
+}
+
+static SDL_Texture* presentDueFrame(VideoState &video, SDL_Renderer* renderer, double clockTime)
+{
+    for (;;) {
+        VideoFrameSlot *slot = peekReadableSlot(video.frameQueue);
+        if (!slot) return nullptr;
+
+        //Hold: the oldest frame isn't due yet, keep showing the current one
+        if (slot->pts > clockTime) return nullptr;
+
+        //Drop: a newer frame is already due, so this one would be shown late
+        VideoFrameSlot *next = peekReadableSlot(video.frameQueue, 1);
+        if (next && next->pts <= clockTime) {
+            ++video.stats.framesDropped;
+            releaseSlot(video, slot);
+            continue;
+        }
+
+        if (clockTime - slot->pts > video.frameDuration) {
+            ++video.stats.framesLate;
+        }
+        ++video.stats.framesPresented;
+        return uploadSlot(video, renderer, slot);
+    }
+}
+
+SDL_Texture* presentVideoFrame(VideoState &video, SDL_Renderer* renderer, double clockTime)
+{
+    if (video.paused) return nullptr;
+    video.presentClock = clockTime;
+
+    //Texture creation is the only allocation expected on this side
+    bool steadyState = video.videoTexture != nullptr;
+    Uint64 allocationMark = getThreadAllocationCount();
+    SDL_Texture *texture = presentDueFrame(video, renderer, clockTime);
+    if (steadyState) video.stats.steadySdlAndNewAllocations += getThreadAllocationCount() - allocationMark;
+    return texture;
+}
+
+bool getNextVideoFrameTime(VideoState &video, double &pts)
+{
+    if (video.paused) return false;
+    VideoFrameSlot *slot = peekReadableSlot(video.frameQueue);
+    if (!slot) return false;
+    pts = slot->pts;
+    return true;
+}
+
+void destroyVideoTexture(VideoState &video)
+{
+    if (video.videoTexture) {
+        SDL_DestroyTexture(video.videoTexture);
+        video.videoTexture = nullptr;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef VIDEO_DECODER_H
+#define VIDEO_DECODER_H
+
+#include <SDL3/SDL.h>
+
+#include "videoRendering.h"
+
+//Starts a worker thread that demuxes, decodes and converts frames from an
+//already loaded VideoState into its frame queue. The render thread must not
+//touch pFormatCtx, pCodecCtx or swsCtx until stopVideoDecoder() returns.
+bool startVideoDecoder(VideoState &video);
+//Sets up the clip's soundtrack for playback: resamples to audioSpec and
+//binds a stream to audioDevice, which the caller keeps open (the audio
+//engine's device). Call before starting the decoder; without it the clip
+//plays silently.
+bool openVideoAudio(VideoState &video);
+void stopVideoDecoder(VideoState &video);
+
+//The player stays open across scene changes. Pausing freezes the clock and
+//lets the worker idle on a full queue; resuming continues where it left off.
+void pauseVideo(VideoState &video);
+void resumeVideo(VideoState &video);
+//Media time the device has actually played of the clip's own soundtrack.
+//Returns false when there is no soundtrack or it isn't advancing.
+bool getVideoAudioClock(VideoState &video, double &audioTime);
+//Media time the oldest queued frame is due at, so the caller can sleep
+//until then. Returns false while paused or when nothing is queued yet.
+bool getNextVideoFrameTime(VideoState &video, double &pts);
+//Where the clock currently is within one pass of a looping clip
+double getVideoClipPosition(VideoState &video);
+void logVideoPlaybackStats(const VideoState &video);
+//Stops the worker and releases every decoder and presentation resource
+void closeVideo(VideoState &video);
+
+//Render thread side: uploads the oldest decoded frame, if any, into the
+//VideoState's streaming texture and returns it. The texture stays owned by
+//the VideoState. Returns nullptr without blocking when nothing is ready yet.
+SDL_Texture* getNextFrame(VideoState &video, SDL_Renderer* renderer);
+void destroyVideoTexture(VideoState &video);
+
+//Clock-driven variant: presents the newest frame whose PTS has been reached,
+//drops frames that were superseded while the renderer was behind and holds
+//the current texture when the next frame isn't due. Returns the texture only
+//when it changed.
+SDL_Texture* presentVideoFrame(VideoState &video, SDL_Renderer* renderer, double clockTime);
+
+#endif
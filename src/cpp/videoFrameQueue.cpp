@@ -0,0 +1,111 @@
+#include "videoFrameQueue.h"
+
+bool initFrameQueue(VideoFrameQueue &queue)
+{
+    queue.mutex = SDL_CreateMutex();
+    queue.notFull = SDL_CreateCondition();
+    if (!queue.mutex || !queue.notFull) {
+        SDL_Log("Failed to create frame queue sync objects: %s", SDL_GetError());
+        destroyFrameQueue(queue);
+        return false;
+    }
+
+    for (VideoFrameSlot &slot : queue.slots) {
+        slot.frame = av_frame_alloc();
+        if (!slot.frame) {
+            SDL_Log("Failed to allocate frame queue slot");
+            destroyFrameQueue(queue);
+            return false;
+        }
+    }
+
+    resetFrameQueue(queue);
+    return true;
+}
+
+void destroyFrameQueue(VideoFrameQueue &queue)
+{
+    for (VideoFrameSlot &slot : queue.slots) {
+        if (slot.frame) {
+            av_frame_free(&slot.frame);
+        }
+    }
+    if (queue.notFull) {
+        SDL_DestroyCondition(queue.notFull);
+        queue.notFull = nullptr;
+    }
+    if (queue.mutex) {
+        SDL_DestroyMutex(queue.mutex);
+        queue.mutex = nullptr;
+    }
+}
+
+VideoFrameSlot* waitWritableSlot(VideoFrameQueue &queue, Sint32 timeoutMS)
+{
+    SDL_LockMutex(queue.mutex);
+    while (queue.count == VideoFrameQueueSize && !queue.aborted) {
+        if (timeoutMS < 0) {
+            SDL_WaitCondition(queue.notFull, queue.mutex);
+        } else if (timeoutMS == 0 || !SDL_WaitConditionTimeout(queue.notFull, queue.mutex, timeoutMS)) {
+            break;
+        }
+    }
+    bool full = queue.count == VideoFrameQueueSize;
+    VideoFrameSlot *slot = (queue.aborted || full) ? nullptr : &queue.slots[queue.writeIndex];
+    SDL_UnlockMutex(queue.mutex);
+    return slot;
+}
+
+void commitWritableSlot(VideoFrameQueue &queue)
+{
+    SDL_LockMutex(queue.mutex);
+    queue.writeIndex = (queue.writeIndex + 1) % VideoFrameQueueSize;
+    ++queue.count;
+    SDL_UnlockMutex(queue.mutex);
+}
+
+VideoFrameSlot* peekReadableSlot(VideoFrameQueue &queue, int offset)
+{
+    if (!queue.mutex) return nullptr;
+    SDL_LockMutex(queue.mutex);
+    VideoFrameSlot *slot = (queue.count > offset)
+        ? &queue.slots[(queue.readIndex + offset) % VideoFrameQueueSize]
+        : nullptr;
+    SDL_UnlockMutex(queue.mutex);
+    return slot;
+}
+
+void releaseReadableSlot(VideoFrameQueue &queue)
+{
+    SDL_LockMutex(queue.mutex);
+    queue.readIndex = (queue.readIndex + 1) % VideoFrameQueueSize;
+    --queue.count;
+    SDL_SignalCondition(queue.notFull);
+    SDL_UnlockMutex(queue.mutex);
+}
+
+void abortFrameQueue(VideoFrameQueue &queue)
+{
+    if (!queue.mutex) return;
+    SDL_LockMutex(queue.mutex);
+    queue.aborted = true;
+    SDL_BroadcastCondition(queue.notFull);
+    SDL_UnlockMutex(queue.mutex);
+}
+
+bool isFrameQueueAborted(VideoFrameQueue &queue)
+{
+    SDL_LockMutex(queue.mutex);
+    bool aborted = queue.aborted;
+    SDL_UnlockMutex(queue.mutex);
+    return aborted;
+}
+
+//Only safe while no worker is attached to the queue
+void resetFrameQueue(VideoFrameQueue &queue)
+{
+    queue.readIndex = 0;
+    queue.writeIndex = 0;
+    queue.count = 0;
+    queue.aborted = false;
+}
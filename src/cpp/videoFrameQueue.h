@@ -0,0 +1,53 @@
+#ifndef VIDEO_FRAME_QUEUE_H
+#define VIDEO_FRAME_QUEUE_H
+
+#include <SDL3/SDL.h>
+
+extern "C"
+{
+    #include <libavutil/frame.h>
+}
+
+// Number of decoded frames the decoder worker may run ahead of the renderer.
+// The worker blocks once every slot is filled, so memory stays bounded.
+constexpr int VideoFrameQueueSize = 4;
+
+struct VideoFrameSlot
+{
+    AVFrame *frame = nullptr;
+    double pts = 0.0;
+    //True when frame references the decoder's buffers instead of slot storage
+    bool borrowed = false;
+};
+
+// Single producer (decoder worker) / single consumer (render thread) ring.
+// Slot frames are allocated once and their buffers are reused between frames.
+struct VideoFrameQueue
+{
+    VideoFrameSlot slots[VideoFrameQueueSize];
+    int readIndex = 0;
+    int writeIndex = 0;
+    int count = 0;
+    bool aborted = false;
+    SDL_Mutex *mutex = nullptr;
+    SDL_Condition *notFull = nullptr;
+};
+
+bool initFrameQueue(VideoFrameQueue &queue);
+void destroyFrameQueue(VideoFrameQueue &queue);
+
+//Producer side: blocks while the ring is full, for at most timeoutMS when
+//that isn't -1. Returns nullptr once aborted or when the wait timed out.
+VideoFrameSlot* waitWritableSlot(VideoFrameQueue &queue, Sint32 timeoutMS = -1);
+void commitWritableSlot(VideoFrameQueue &queue);
+
+//Consumer side: never blocks, returns nullptr when no frame is ready.
+//offset looks past the oldest frame, e.g. 1 for the frame queued after it.
+VideoFrameSlot* peekReadableSlot(VideoFrameQueue &queue, int offset = 0);
+void releaseReadableSlot(VideoFrameQueue &queue);
+
+void abortFrameQueue(VideoFrameQueue &queue);
+bool isFrameQueueAborted(VideoFrameQueue &queue);
+void resetFrameQueue(VideoFrameQueue &queue);
+
+#endif
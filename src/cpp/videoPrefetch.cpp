@@ -0,0 +1,54 @@
+#include "videoPrefetch.h"
+#include "videoDecoder.h"
+
+static int videoPrefetchThread(void *data)
+{
+    VideoPrefetch &prefetch = *static_cast<VideoPrefetch*>(data);
+    VideoState &video = *prefetch.video;
+
+    //Paused first so the clock holds at zero and the soundtrack isn't bound
+    //to the device until the scene is actually on screen
+    pauseVideo(video);
+    bool ready = prefetch.open(video) && startVideoDecoder(video);
+    if (!ready) {
+        closeVideo(video);
+    }
+    prefetch.succeeded = ready;
+
+    SDL_Log("Video prefetch %s after %.1f ms", ready ? "ready" : "failed",
+            static_cast<double>(SDL_GetTicksNS() - prefetch.startTicksNS) / SDL_NS_PER_MS);
+    return 0;
+}
+
+bool startVideoPrefetch(VideoPrefetch &prefetch, VideoState &video, VideoOpenFunc open)
+{
+    if (prefetch.started) return true;
+
+    prefetch.video = &video;
+    prefetch.open = open;
+    prefetch.succeeded = false;
+    prefetch.startTicksNS = SDL_GetTicksNS();
+    prefetch.thread = SDL_CreateThread(videoPrefetchThread, "VideoPrefetch", &prefetch);
+    if (!prefetch.thread) {
+        SDL_Log("Failed to start video prefetch: %s", SDL_GetError());
+        return false;
+    }
+    prefetch.started = true;
+    return true;
+}
+
+bool isVideoPrefetchStarted(const VideoPrefetch &prefetch)
+{
+    return prefetch.started;
+}
+
+bool finishVideoPrefetch(VideoPrefetch &prefetch)
+{
+    if (!prefetch.started) return false;
+    if (prefetch.thread) {
+        SDL_WaitThread(prefetch.thread, nullptr);
+        prefetch.thread = nullptr;
+    }
+    prefetch.started = false;
+    return prefetch.succeeded;
+}
@@ -0,0 +1,33 @@
+#ifndef VIDEO_PREFETCH_H
+#define VIDEO_PREFETCH_H
+
+#include <SDL3/SDL.h>
+#include <atomic>
+
+#include "videoRendering.h"
+
+//Opens a scene's video on a worker thread ahead of the scene switch: file
+//open, stream probing, codec and audio setup, then starts the decoder so its
+//queue pre-rolls. The video is left paused at media time zero, resumeVideo()
+//starts it.
+typedef bool (*VideoOpenFunc)(VideoState &video);
+
+struct VideoPrefetch
+{
+    SDL_Thread *thread = nullptr;
+    VideoState *video = nullptr;
+    VideoOpenFunc open = nullptr;
+    bool started = false;
+    std::atomic<bool> succeeded{false};
+    Uint64 startTicksNS = 0;
+};
+
+//The VideoState belongs to the prefetch worker until finishVideoPrefetch()
+//returns, the caller must not touch it in between
+bool startVideoPrefetch(VideoPrefetch &prefetch, VideoState &video, VideoOpenFunc open);
+bool isVideoPrefetchStarted(const VideoPrefetch &prefetch);
+//Waits for the worker if it is still opening the video. Returns whether the
+//video is ready to play; the prefetch can be started again afterwards.
+bool finishVideoPrefetch(VideoPrefetch &prefetch);
+
+#endif
@@ -35,18 +35,163 @@ static inline __attribute__((unused)) uint64_t av_get_default_channel_layout(int
 }
 #endif
 
-// Global variable for audio device
-SDL_AudioDeviceID audioDevice;
-SDL_AudioStream* audioStream = nullptr;
-Uint8* audioBuffer = nullptr;
-Uint32 audioLength = 0;
+//libavcodec warns about and gains little from more threads than this
+constexpr int MaxDecodeThreads = 16;
 
-bool loadMP4(const std::string &filename, VideoState &video)
+VideoDecodeOptions videoDecodeOptionsFromEnvironment()
 {
+    VideoDecodeOptions options;
+
+    if (const char *threads = SDL_getenv("ATARAXIA_VIDEO_THREADS")) {
+        options.threadCount = SDL_atoi(threads);
+    }
+    if (const char *mode = SDL_getenv("ATARAXIA_VIDEO_THREAD_MODE")) {
+        if (SDL_strcasecmp(mode, "frame") == 0) options.threadMode = VideoThreadMode::FRAME;
+        else if (SDL_strcasecmp(mode, "slice") == 0) options.threadMode = VideoThreadMode::SLICE;
+        else if (SDL_strcasecmp(mode, "none") == 0) options.threadMode = VideoThreadMode::NONE;
+        else options.threadMode = VideoThreadMode::AUTO;
+    }
+    if (const char *preview = SDL_getenv("ATARAXIA_VIDEO_PREVIEW")) {
+        options.fastPreview = SDL_atoi(preview) != 0;
+    }
+    if (const char *lowres = SDL_getenv("ATARAXIA_VIDEO_LOWRES")) {
+        options.lowres = SDL_atoi(lowres);
+    }
+    if (const char *native = SDL_getenv("ATARAXIA_VIDEO_NATIVE_SIZE")) {
+        options.nativeSize = SDL_atoi(native) != 0;
+    }
+    return options;
+}
+
+static void applyDecodeOptions(AVCodecContext *codecCtx, const AVCodec *codec,
+                               const VideoDecodeOptions &options)
+{
+    int threadCount = options.threadCount > 0 ? options.threadCount : SDL_GetNumLogicalCPUCores();
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > MaxDecodeThreads) threadCount = MaxDecodeThreads;
+
+    int threadType = 0;
+    switch (options.threadMode) {
+        case VideoThreadMode::AUTO:
+            threadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+            break;
+        case VideoThreadMode::FRAME:
+            threadType = FF_THREAD_FRAME;
+            break;
+        case VideoThreadMode::SLICE:
+            threadType = FF_THREAD_SLICE;
+            break;
+        case VideoThreadMode::NONE:
+            threadCount = 1;
+            break;
+    }
+    codecCtx->thread_count = threadCount;
+    codecCtx->thread_type = threadType;
+
+    int lowres = 0;
+    if (options.fastPreview) {
+        codecCtx->skip_loop_filter = AVDISCARD_ALL;
+        codecCtx->flags2 |= AV_CODEC_FLAG2_FAST;
+        lowres = options.lowres < 0 ? 0 : options.lowres;
+    }
+    //Halve for as long as the picture still covers the target
+    if (!options.nativeSize && options.targetWidth > 0 && options.targetHeight > 0) {
+        while ((codecCtx->width >> (lowres + 1)) >= options.targetWidth &&
+               (codecCtx->height >> (lowres + 1)) >= options.targetHeight) {
+            ++lowres;
+        }
+    }
+    codecCtx->lowres = lowres > codec->max_lowres ? codec->max_lowres : lowres;
+}
+
+//Opens the clip's soundtrack if it has one. A clip without usable audio
+//still plays, just silently.
+static void loadMP4Audio(VideoState &video)
+{
+    int index = av_find_best_stream(video.pFormatCtx, AVMEDIA_TYPE_AUDIO, -1, video.videoStream, nullptr, 0);
+    if (index < 0)
+    {
+        std::cout << "No audio stream in clip\n";
+        return;
+    }
+
+    AVStream *stream = video.pFormatCtx->streams[index];
+    video.pAudioCodec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!video.pAudioCodec)
+    {
+        std::cout << "Error: Unsupported audio codec\n";
+        return;
+    }
+
+    video.pAudioCodecCtx = avcodec_alloc_context3(video.pAudioCodec);
+    if (!video.pAudioCodecCtx ||
+        avcodec_parameters_to_context(video.pAudioCodecCtx, stream->codecpar) < 0)
+    {
+        std::cout << "Error: Could not copy audio codec parameters\n";
+        avcodec_free_context(&video.pAudioCodecCtx);
+        return;
+    }
+    video.pAudioCodecCtx->pkt_timebase = stream->time_base;
+
+    if (avcodec_open2(video.pAudioCodecCtx, video.pAudioCodec, nullptr) < 0)
+    {
+        std::cout << "Error: Could not open audio codec\n";
+        avcodec_free_context(&video.pAudioCodecCtx);
+        return;
+    }
+
+    video.pAudioFrame = av_frame_alloc();
+    video.audioStreamIndex = index;
+    std::cout << "Audio: " << video.pAudioCodec->name << ", " << video.pAudioCodecCtx->sample_rate
+              << " Hz, " << video.pAudioCodecCtx->ch_layout.nb_channels << " channels" << std::endl;
+}
+
+//Opens the container through a memory mapping of the file (or slice),
+//falling back to FFmpeg's own file protocol when mapping isn't possible
+static bool openVideoInput(VideoState &video, const std::string &filename, Uint64 offset, Uint64 length)
+{
+    if (openMappedMedia(video.media, filename, offset, length))
+    {
+        video.pFormatCtx = avformat_alloc_context();
+        if (video.pFormatCtx)
+        {
+            video.pFormatCtx->pb = video.media.avio;
+            video.pFormatCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+            //The name is only a probing hint here
+            if (avformat_open_input(&video.pFormatCtx, filename.c_str(), nullptr, nullptr) == 0)
+            {
+                std::cout << "Mapped " << video.media.size << " bytes of " << filename << std::endl;
+                return true;
+            }
+        }
+        //avformat_open_input frees the context on failure
+        closeMappedMedia(video.media);
+    }
+    if (offset != 0 || length != 0)
+    {
+        return false;
+    }
+    return avformat_open_input(&video.pFormatCtx, filename.c_str(), nullptr, nullptr) == 0;
+}
+
+bool loadMP4(const std::string &filename, VideoState &video, const VideoDecodeOptions &options)
+{
+    return loadMP4Slice(filename, 0, 0, video, options);
+}
+
+bool loadMP4Slice(const std::string &assetFile, Uint64 offset, Uint64 length, VideoState &video,
+                  const VideoDecodeOptions &options)
+{
+    //Slices of one packed file are distinct clips to the cache
+    std::string filename = assetFile;
+    if (offset != 0 || length != 0)
+    {
+        filename += "#" + std::to_string(offset) + "+" + std::to_string(length);
+    }
+
     avformat_network_init();
     
-    if (avformat_open_input(
-        &video.pFormatCtx, filename.c_str(), nullptr, nullptr) !=0)
+    if (!openVideoInput(video, assetFile, offset, length))
     {
         std::cout << "Error: Could not open video file " << 
         filename << std::endl;
@@ -93,202 +238,33 @@ bool loadMP4(const std::string &filename, VideoState &video)
         return false;
     }
     
+    applyDecodeOptions(video.pCodecCtx, video.pCodec, options);
+
     if (avcodec_open2(video.pCodecCtx, video.pCodec, nullptr) < 0)
     {
         std::cout << "Error: Could not open codec\n";
         return false;
     }
-    
-    std::cout << "Sucessfully loaded MP4: " << filename << std::endl;
-    return true;
-}
-
-bool loadAudioFile(const std::string &filename) {
-    SDL_AudioSpec wavSpec;
-
-    cleanupAudio();
-    
-    SDL_Log("Attempting to load: %s", filename.c_str());
-
-    if (!SDL_LoadWAV(filename.c_str(), &wavSpec, &audioBuffer, &audioLength)) {
-        SDL_Log("Failed to load WAV file: %s", SDL_GetError());
-        return false;
-    }
-    
-    SDL_Log("WAV loaded - Format: %u, Channels: %u, Freq: %d, Size: %u bytes", 
-           wavSpec.format, wavSpec.channels, wavSpec.freq, audioLength);
-    
-    SDL_AudioSpec deviceSpec;
-    SDL_zero(deviceSpec);
-    deviceSpec.freq = wavSpec.freq;
-    deviceSpec.format = wavSpec.format;
-    deviceSpec.channels = wavSpec.channels;
-    
-    audioDevice = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &deviceSpec);
-    if (!audioDevice) {
-        SDL_Log("Failed to open audio device: %s", SDL_GetError());
-        SDL_free(audioBuffer);
-        audioBuffer = nullptr;
-        return false;
-    }
-    
-    audioStream = SDL_CreateAudioStream(&wavSpec, &deviceSpec);
-    if (!audioStream) {
-        SDL_Log("Failed to create audio stream: %s", SDL_GetError());
-        SDL_CloseAudioDevice(audioDevice);
-        SDL_free(audioBuffer);
-        audioBuffer = nullptr;
-        return false;
-    }
-    
-    Uint32 MAX_CHUNK_SIZE = 4096;
-    Uint32 processedBytes = 0;
-    
-    while (processedBytes < audioLength) {
-        int chunkSize = (audioLength - processedBytes < MAX_CHUNK_SIZE) ? 
-                         audioLength - processedBytes : MAX_CHUNK_SIZE;
-        
-        int result = SDL_PutAudioStreamData(audioStream, 
-                                           audioBuffer + processedBytes, 
-                                           chunkSize);
-        
-        if (result < 0) {
-            SDL_Log("Error queueing audio chunk: %s", SDL_GetError());
-            SDL_DestroyAudioStream(audioStream);
-            audioStream = nullptr;
-            SDL_CloseAudioDevice(audioDevice);
-            SDL_free(audioBuffer);
-            audioBuffer = nullptr;
-            return false;
-        }
-        
-        processedBytes += chunkSize;
-    }
-    
-    SDL_FlushAudioStream(audioStream);
-    return true;
-}
 
-
-void playAudio() {
-    SDL_Log("Inside playAudio() function");
-
-    if (!audioDevice) {
-        SDL_Log("ERROR: No audio device available");
-        return;
-    }
+    std::cout << "Decoder threads: " << video.pCodecCtx->thread_count
+              << " (active type " << video.pCodecCtx->active_thread_type << ")"
+              << ", lowres " << video.pCodecCtx->lowres
+              << (options.fastPreview ? ", fast preview" : "") << std::endl;
     
-    if (!audioStream) {
-        SDL_Log("ERROR: No audio stream available");
-        return;
-    }
-
-    SDL_Log("Flushing audio stream before binding...");
-    SDL_FlushAudioStream(audioStream);
-
-    SDL_Log("Binding audio stream to device %u", audioDevice);
-    
-    int result = SDL_BindAudioStream(audioDevice, audioStream);
-    if (result != 0) {
-        SDL_Log("ERROR: Failed to bind audio stream: %s (Error code: %d)", SDL_GetError(), result);
-        return;
-    }
-    
-}
-
-//This can be used to explicitly call each SFX. Less modular than what I want
-//But it works
-void playSFX()
-{
-    SDL_Log("Inside playAudio() function");
-
-    std::string audioPath = "assets/audio/blip.wav";
-    SDL_Log("Reloading audio file: %s", audioPath.c_str());
-
-    if (!loadAudioFile(audioPath)) {
-        SDL_Log("ERROR: Failed to reload audio file.");
-        return;
-    }
-
-    SDL_Log("Audio file reloaded successfully, playing now...");
-
-    if (!audioDevice) {
-        SDL_Log("ERROR: No audio device available");
-        return;
-    }
-    
-    if (!audioStream) {
-        SDL_Log("ERROR: No audio stream available");
-        return;
-    }
-
-    SDL_Log("Flushing audio stream before binding...");
-    SDL_FlushAudioStream(audioStream);
-
-    SDL_Log("Binding audio stream to device %u", audioDevice);
-    
-    int result = SDL_BindAudioStream(audioDevice, audioStream);
-    if (result != 0) {
-        SDL_Log("ERROR: Failed to bind audio stream: %s (Error code: %d)", SDL_GetError(), result);
-        return;
-    }
-
-    SDL_Log("Audio should now be playing.");
-    cleanupAudio();
-}
-
-void cleanupAudio() {
-    SDL_Log("Cleaning up audio resources");
-    
-    if (audioStream) {
-        SDL_Log("Destroying audio stream");
-        SDL_DestroyAudioStream(audioStream);
-        audioStream = nullptr;
-    }
-
-    if (audioDevice) {
-        SDL_Log("Closing audio device %u", audioDevice);
-        SDL_CloseAudioDevice(audioDevice);
-        audioDevice = 0;
+    if (!options.nativeSize)
+    {
+        video.targetWidth = options.targetWidth;
+        video.targetHeight = options.targetHeight;
     }
-
-    if (audioBuffer) {
-        SDL_Log("Freeing audio buffer");
-        SDL_free(audioBuffer);
-        audioBuffer = nullptr;
+    std::cout << "Decoded size: " << video.pCodecCtx->width << "x" << video.pCodecCtx->height;
+    if (video.targetWidth > 0 && video.targetHeight > 0)
+    {
+        std::cout << ", fitted to " << video.targetWidth << "x" << video.targetHeight;
     }
-    
-    SDL_Log("Audio cleanup complete");
-}
+    std::cout << std::endl;
 
-bool testAudioPlayback() {
-    SDL_Log("===== TESTING AUDIO PLAYBACK =====");
-    
-    std::string audioPath = "assets/video/NeverGonna.wav";
-    SDL_Log("Testing audio file: %s", audioPath.c_str());
-    
-    SDL_IOStream* file = SDL_IOFromFile(audioPath.c_str(), "rb");
-    if (!file) {
-        SDL_Log("TEST FAILED: Audio file not found at: %s", audioPath.c_str());
-        return false;
-    }
-    SDL_CloseIO(file);
-    SDL_Log("TEST: File exists");
-    
-    if (!loadAudioFile(audioPath)) {
-        SDL_Log("TEST FAILED: Could not load audio file");
-        return false;
-    }
-    SDL_Log("TEST: Audio file loaded successfully");
-    
-    playAudio();
-    SDL_Log("TEST: Audio playback initiated");
-    
-    SDL_Log("TEST: Waiting for 5 seconds to let audio play...");
-    SDL_Delay(5000);
-    
-    cleanupAudio();
-    SDL_Log("TEST: Audio resources cleaned up");
-    
+    loadMP4Audio(video);
+    video.sourcePath = filename;
+    std::cout << "Sucessfully loaded MP4: " << filename << std::endl;
     return true;
-}
\ No newline at end of file
+}
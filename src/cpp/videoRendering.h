@@ -2,65 +2,170 @@
 #define VIDEO_RENDERING_H
 
 #include <string>
+#include <vector>
+#include <atomic>
 #include <SDL3/SDL.h>
 
+#include "videoFrameQueue.h"
+#include "playbackClock.h"
+#include "mediaIO.h"
+
 extern "C"
 {
     #include <libavcodec/avcodec.h>
     #include <libavformat/avformat.h>
     #include <libswscale/swscale.h>
     #include <libavutil/imgutils.h>
+    #include <libswresample/swresample.h>
 }
 
-extern SDL_AudioDeviceID audioDevice;
-extern SDL_AudioStream* audioStream;
-extern Uint8* audioBuffer;
-extern Uint32 audioLength;
+//How decoded frames reach the GPU. STREAMING_YUV uploads the decoder's
+//planes straight into one IYUV/NV12 texture; RGB_CONVERT converts to RGBA on
+//the worker (SIMD kernels for 4:2:0, sws_scale otherwise) for renderers that
+//can't sample YUV directly.
+enum class VideoPlaybackMode
+{
+    STREAMING_YUV,
+    RGB_CONVERT
+};
+
+//Decoder threading model handed to libavcodec
+enum class VideoThreadMode
+{
+    AUTO,       //frame and slice threading, whichever the codec supports
+    FRAME,
+    SLICE,
+    NONE
+};
+
+struct VideoDecodeOptions
+{
+    VideoThreadMode threadMode = VideoThreadMode::AUTO;
+    int threadCount = 0;        //0 picks one thread per logical core
+    //Fast preview tier: skips the loop filter, allows non-spec-compliant
+    //speedups and decodes at 1/2^lowres resolution when the codec can
+    bool fastPreview = false;
+    int lowres = 1;
+    //Size of the rect the video is drawn into. When set, the decoder uses
+    //lowres where the codec allows it and frames are downscaled once during
+    //conversion, so uploads are no bigger than what is shown. 0 keeps the
+    //clip's own size.
+    int targetWidth = 0;
+    int targetHeight = 0;
+    bool nativeSize = false;    //ignore the target, for comparisons
+};
+
+//Reads ATARAXIA_VIDEO_THREADS, ATARAXIA_VIDEO_THREAD_MODE (auto/frame/slice/none),
+//ATARAXIA_VIDEO_PREVIEW, ATARAXIA_VIDEO_LOWRES and ATARAXIA_VIDEO_NATIVE_SIZE
+//so the decode tier can be changed per machine without recompiling.
+VideoDecodeOptions videoDecodeOptionsFromEnvironment();
+
+//Playback health counters, written by the decoder worker and render thread
+struct VideoPlaybackStats
+{
+    std::atomic<Uint64> framesDecoded{0};
+    std::atomic<Uint64> framesPresented{0};
+    std::atomic<Uint64> framesLate{0};        //presented more than a frame behind the clock
+    std::atomic<Uint64> framesDropped{0};     //superseded in the queue before presentation
+    std::atomic<Uint64> framesDiscarded{0};   //already late when the worker produced them
+    std::atomic<Uint64> packetsSkipped{0};    //thrown away while seeking the next keyframe
+    //After the first frame, ALLOC_DEBUG builds only. Covers SDL_malloc and
+    //operator new; libav allocates through av_malloc, which can't be hooked,
+    //so its packet buffers are counted by how many packets were demuxed.
+    std::atomic<Uint64> steadySdlAndNewAllocations{0};
+    std::atomic<Uint64> steadyPacketsDemuxed{0};
+};
+
+//Per-frame time spent in each stage of the worker, recorded only when a
+//profiler (the decode benchmark) attaches one before starting the decoder.
+//Read it after stopVideoDecoder().
+struct VideoStageTimings
+{
+    std::vector<Uint64> demuxNS;
+    std::vector<Uint64> decodeNS;
+    std::vector<Uint64> convertNS;
+};
 
 struct VideoState
 {
     //Video Component
     AVFormatContext *pFormatCtx = nullptr;
+    MappedMedia media;      //backs pFormatCtx when the file could be mapped
     AVCodecContext *pCodecCtx = nullptr;
     const AVCodec *pCodec = nullptr;
     AVFrame *pFrame = nullptr;
-    AVFrame *pFrameRGB = nullptr;
     SwsContext *swsCtx = nullptr;
-    uint8_t *buffer = nullptr;
     int videoStream = -1;
+
+    //Decoder worker, owns the contexts above while running
+    SDL_Thread *decodeThread = nullptr;
+    std::atomic<bool> decodeRunning{false};
+    std::atomic<bool> decodeFinished{false};
+    VideoFrameQueue frameQueue;
+
+    //Looping restarts the clip by seeking instead of reopening the file.
+    //Queued frame PTS keep increasing across loops, clipDuration is the
+    //length of one pass.
+    bool looping = true;
+    bool paused = false;
+    std::atomic<double> clipDuration{0.0};
+
+    //Cache mode: short clips are decoded once into the shared clip cache
+    //(see videoCache.h) and replayed from memory on later loops and visits
+    bool cacheEnabled = false;
+    std::string sourcePath;
+
+    //Presentation, one streaming texture reused for every frame
+    //Output size frames are fitted within, 0 for the decoded size
+    int targetWidth = 0;
+    int targetHeight = 0;
+    VideoPlaybackMode playbackMode = VideoPlaybackMode::STREAMING_YUV;
+    SDL_Texture *videoTexture = nullptr;
+    PlaybackClock clock;
+    double frameDuration = 1.0 / 30.0;
+    //Clock value at the last present, lets the worker tell when it is behind
+    std::atomic<double> presentClock{-1.0};
+    VideoPlaybackStats stats;
+    VideoStageTimings *stageTimings = nullptr;
     
-    //Audio Component
+    //Audio Component, the clip's own soundtrack. The decoder worker resamples
+    //it to audioSpec and feeds audioStream as it demuxes.
     int audioStreamIndex = -1;
     SDL_AudioStream* audioStream = nullptr;
     AVCodecContext *pAudioCodecCtx = nullptr;
     const AVCodec *pAudioCodec = nullptr;
-    SDL_AudioDeviceID audioDevice = 0;
+    AVFrame *pAudioFrame = nullptr;
+    SwrContext *swrCtx = nullptr;
+    std::vector<Uint8> audioPcm;
+    std::atomic<Uint64> audioBytesQueued{0};
+    SDL_AudioDeviceID audioDevice = 0;     //borrowed, the audio engine owns it
     Uint8* audioBuffer = nullptr;
     Uint32 audioLength = 0;
     SDL_AudioSpec audioSpec;
 
     VideoState() : pFormatCtx(nullptr), pCodecCtx(nullptr), pCodec(nullptr),
-                   pFrame(nullptr), pFrameRGB(nullptr), swsCtx(nullptr),
-                   buffer(nullptr), videoStream(-1) {}
+                   pFrame(nullptr), swsCtx(nullptr), videoStream(-1) {}
 
     ~VideoState()
     {
-        if (buffer) av_free(buffer);
-        if (pFrameRGB) av_frame_free(&pFrameRGB);
+        destroyFrameQueue(frameQueue);
         if (pFrame) av_frame_free(&pFrame);
         if (pCodecCtx) avcodec_free_context(&pCodecCtx);
         if (pFormatCtx) avformat_close_input(&pFormatCtx);
+        closeMappedMedia(media);
         if (swsCtx) sws_freeContext(swsCtx);
         if (audioStream) SDL_DestroyAudioStream(audioStream);
+        if (swrCtx) swr_free(&swrCtx);
+        if (pAudioFrame) av_frame_free(&pAudioFrame);
         if (pAudioCodecCtx) avcodec_free_context(&pAudioCodecCtx);
     }
 };
 
 
-bool loadMP4(const std::string &filename, VideoState &video);
-bool loadAudioFile(const std::string &filename);
-void playAudio();
-void cleanupAudio();
-void playSFX();
+bool loadMP4(const std::string &filename, VideoState &video,
+             const VideoDecodeOptions &options = VideoDecodeOptions());
+//Loads a clip stored at [offset, offset + length) inside a packed asset file
+bool loadMP4Slice(const std::string &assetFile, Uint64 offset, Uint64 length, VideoState &video,
+                  const VideoDecodeOptions &options = VideoDecodeOptions());
 
 #endif
\ No newline at end of file
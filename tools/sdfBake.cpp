@@ -0,0 +1,34 @@
+// Bakes a font's signed distance field into the cache file the game loads at
+// startup, so shipping builds never rasterize glyphs.
+//
+//   make sdf-cache
+//   ./sdfBake assets/fonts/ArianaVioleta.ttf assets/fonts/ArianaVioleta.sdf
+
+#include <SDL3/SDL.h>
+#include <SDL3_ttf/SDL_ttf.h>
+#include <cstdio>
+
+#include "sdfFont.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s <font.ttf> <out.sdf>\n", argv[0]);
+        return 1;
+    }
+    if (!TTF_Init()) {
+        std::fprintf(stderr, "TTF_Init failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    SdfFont font;
+    Uint64 start = SDL_GetTicksNS();
+    bool ok = bakeSdfFont(font, argv[1]) && saveSdfFont(font, argv[2]);
+    if (ok) {
+        std::printf("%s: %dx%d field, %zu kerning pairs, baked in %.1f ms\n", argv[2],
+                    font.fieldWidth, font.fieldHeight, font.kerning.size(),
+                    (SDL_GetTicksNS() - start) / 1000000.0);
+    }
+    TTF_Quit();
+    return ok ? 0 : 1;
+}